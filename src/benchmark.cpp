@@ -18,7 +18,6 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <fstream>
 #include <iostream>
 #include <istream>
 #include <vector>
@@ -100,6 +99,7 @@ const vector<string> Defaults = {
 /// bench 64 4 5000 current movetime -> search current position with 4 threads for 5 sec
 /// bench 64 1 100000 default nodes -> search default positions for 100K nodes each
 /// bench 16 1 5 default perft -> run a perft 5 on default positions
+/// bench 16 1 10 games.epd -> search each FEN or EPD line of a file to depth 10
 
 vector<string> setup_bench(const Position& current, istream& is) {
 
@@ -115,6 +115,10 @@ vector<string> setup_bench(const Position& current, istream& is) {
 
   go = "go " + limitType + " " + limit;
 
+  list.emplace_back("ucinewgame");
+  list.emplace_back("setoption name Threads value " + threads);
+  list.emplace_back("setoption name Hash value " + ttSize);
+
   if (fenFile == "default")
       fens = Defaults;
 
@@ -123,26 +127,13 @@ vector<string> setup_bench(const Position& current, istream& is) {
 
   else
   {
-      string fen;
-      ifstream file(fenFile);
-
-      if (!file.is_open())
-      {
-          cerr << "Unable to open file " << fenFile << endl;
-          exit(EXIT_FAILURE);
-      }
-
-      while (getline(file, fen))
-          if (!fen.empty())
-              fens.push_back(fen);
-
-      file.close();
+      // The positions of a file are read in place by the bench loop, which
+      // runs the go command once for each of them.
+      list.emplace_back("fenfile " + fenFile);
+      list.emplace_back(go);
+      return list;
   }
 
-  list.emplace_back("ucinewgame");
-  list.emplace_back("setoption name Threads value " + threads);
-  list.emplace_back("setoption name Hash value " + ttSize);
-
   for (const string& fen : fens)
       if (fen.find("setoption") != string::npos)
           list.emplace_back(fen);
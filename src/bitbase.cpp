@@ -19,8 +19,10 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <numeric>
+#include <thread>
 #include <vector>
 
 #include "bitboard.h"
@@ -70,6 +72,27 @@ namespace {
     Result result;
   };
 
+  // KXK bitbases, one for each fairy piece type X, store the positions won by
+  // the side with the fairy piece.
+  constexpr unsigned KXK_INDEX = 2*64*64*64; // stm * xsq * bksq * wksq = 524288
+  constexpr int FAIRY_NB = FORTRESS - CANNON + 1;
+
+  uint32_t KXKBitbase[FAIRY_NB][KXK_INDEX / 32];
+  std::atomic<bool> KXKSolved[FAIRY_NB];
+  std::thread KXKSolver;
+
+  // A KXK bitbase index is an integer in [0, KXK_INDEX] range
+  //
+  // bit  0- 5: white king square (from SQ_A1 to SQ_H8)
+  // bit  6-11: black king square (from SQ_A1 to SQ_H8)
+  // bit 12-17: white fairy piece square (from SQ_A1 to SQ_H8)
+  // bit    18: side to move (WHITE or BLACK)
+  unsigned kxk_index(Color us, Square bksq, Square wksq, Square xsq) {
+    return wksq | (bksq << 6) | (xsq << 12) | (us << 18);
+  }
+
+  void init_kxk(PieceType pt);
+
 } // namespace
 
 
@@ -81,6 +104,31 @@ bool Bitbases::probe(Square wksq, Square wpsq, Square bksq, Color us) {
   return KPKBitbase[idx / 32] & (1 << (idx & 0x1F));
 }
 
+bool Bitbases::probe(PieceType pt, Square wksq, Square xsq, Square bksq, Color us) {
+
+  assert(pt >= CANNON && pt <= FORTRESS);
+  assert(solved(pt));
+
+  unsigned idx = kxk_index(us, bksq, wksq, xsq);
+  return KXKBitbase[pt - CANNON][idx / 32] & (1 << (idx & 0x1F));
+}
+
+bool Bitbases::solved(PieceType pt) {
+
+  return KXKSolved[pt - CANNON].load(std::memory_order_acquire);
+}
+
+
+/// Bitbases::wait() waits until all the KX vs K bitbases are solved. It is
+/// called between games and on 'isready', so that searches normally find them
+/// ready, and before exit.
+
+void Bitbases::wait() {
+
+  if (KXKSolver.joinable())
+      KXKSolver.join();
+}
+
 
 void Bitbases::init() {
 
@@ -101,6 +149,16 @@ void Bitbases::init() {
   for (idx = 0; idx < MAX_INDEX; ++idx)
       if (db[idx] == WIN)
           KPKBitbase[idx / 32] |= 1 << (idx & 0x1F);
+
+  // The KX vs K bitbases take a while to solve and few games reach them, so
+  // they are solved by a background thread, off the start up and search paths.
+  KXKSolver = std::thread([]() {
+      for (PieceType pt = CANNON; pt <= FORTRESS; ++pt)
+      {
+          init_kxk(pt);
+          KXKSolved[pt - CANNON].store(true, std::memory_order_release);
+      }
+  });
 }
 
 
@@ -177,4 +235,116 @@ namespace {
     return result = r & Good  ? Good  : r & UNKNOWN ? UNKNOWN : Bad;
   }
 
+
+  // init_kxk() solves KX vs K by retrograde analysis. Mates with black to move
+  // are found first, then the wins are propagated backwards: a white to move
+  // position is won if one move leads to a won position, a black to move one
+  // when all its moves do. Black to move entries count the moves not yet known
+  // to lose. Fairy piece moves are symmetric, so the squares a piece can come
+  // from are the ones it attacks.
+
+  void init_kxk(PieceType pt) {
+
+    constexpr uint8_t Invalid = 255, Draw = 254, Win = 253;
+
+    std::vector<uint8_t> db(KXK_INDEX);
+    std::vector<unsigned> queue;
+
+    for (unsigned idx = 0; idx < KXK_INDEX; ++idx)
+    {
+        Square wksq = Square(idx & 0x3F), bksq = Square((idx >> 6) & 0x3F);
+        Square xsq  = Square((idx >> 12) & 0x3F);
+        Color us    = Color(idx >> 18);
+
+        if (   distance(wksq, bksq) <= 1
+            || xsq == wksq
+            || xsq == bksq)
+        {
+            db[idx] = Invalid;
+            continue;
+        }
+
+        bool check = attacks_bb(WHITE, pt, xsq, SquareBB[wksq] | bksq) & bksq;
+
+        if (us == WHITE)
+        {
+            db[idx] = check ? Invalid : 0;
+            continue;
+        }
+
+        // Count black legal moves. Capturing the undefended piece is a draw.
+        Bitboard b = PseudoAttacks[BLACK][KING][bksq] & ~PseudoAttacks[WHITE][KING][wksq];
+        int cnt = 0;
+
+        if (b & xsq)
+            db[idx] = Draw;
+        else
+        {
+            while (b)
+            {
+                Square to = pop_lsb(&b);
+                cnt += !(attacks_bb(WHITE, pt, xsq, SquareBB[wksq] | to) & to);
+            }
+
+            db[idx] = cnt ? uint8_t(cnt) : check ? Win : Draw;
+
+            if (db[idx] == Win)
+                queue.push_back(idx);
+        }
+    }
+
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        unsigned idx = queue[i];
+        Square wksq = Square(idx & 0x3F), bksq = Square((idx >> 6) & 0x3F);
+        Square xsq  = Square((idx >> 12) & 0x3F);
+        Bitboard occupied = SquareBB[wksq] | bksq | xsq;
+
+        if (Color(idx >> 18) == BLACK)
+        {
+            // White just moved, either the king or the fairy piece
+            Bitboard b = PseudoAttacks[WHITE][KING][wksq] & ~occupied;
+            while (b)
+            {
+                unsigned p = kxk_index(WHITE, bksq, pop_lsb(&b), xsq);
+                if (!db[p])
+                {
+                    db[p] = Win;
+                    queue.push_back(p);
+                }
+            }
+
+            b = attacks_bb(WHITE, pt, xsq, occupied) & ~occupied;
+            while (b)
+            {
+                unsigned p = kxk_index(WHITE, bksq, wksq, pop_lsb(&b));
+                if (!db[p])
+                {
+                    db[p] = Win;
+                    queue.push_back(p);
+                }
+            }
+        }
+        else
+        {
+            // Black just moved the king
+            Bitboard b = PseudoAttacks[BLACK][KING][bksq] & ~occupied;
+            while (b)
+            {
+                unsigned p = kxk_index(BLACK, pop_lsb(&b), wksq, xsq);
+                if (db[p] < Win && db[p] && !--db[p])
+                {
+                    db[p] = Win;
+                    queue.push_back(p);
+                }
+            }
+        }
+    }
+
+    // Map 32 results into one KXKBitbase[] entry
+    for (unsigned idx = 0; idx < KXK_INDEX; ++idx)
+        if (db[idx] == Win)
+            KXKBitbase[pt - CANNON][idx / 32] |= 1 << (idx & 0x1F);
+  }
+
 } // namespace
@@ -28,7 +28,10 @@
 namespace Bitbases {
 
 void init();
+void wait();
+bool solved(PieceType pt);
 bool probe(Square wksq, Square wpsq, Square bksq, Color us);
+bool probe(PieceType pt, Square wksq, Square xsq, Square bksq, Color us);
 
 }
 
@@ -177,6 +180,19 @@ constexpr Bitboard shift(Bitboard b) {
 }
 
 
+/// fill() extends each bit of a bitboard along direction D, NORTH or SOUTH, up
+/// to the edge of the board (mainly for set-wise pawn evaluation)
+
+template<Direction D>
+inline Bitboard fill(Bitboard b) {
+  static_assert(D == NORTH || D == SOUTH, "Fill only along files");
+  b |= D == NORTH ? b << 8  : b >> 8;
+  b |= D == NORTH ? b << 16 : b >> 16;
+  b |= D == NORTH ? b << 32 : b >> 32;
+  return b;
+}
+
+
 /// pawn_attacks_bb() returns the pawn attacks for the given color from the
 /// squares in the given bitboard.
 
@@ -99,6 +99,9 @@ Endgames::Endgames() {
   add<KQKP>("KQKP");
   add<KQKR>("KQKR");
 
+  for (string code : { "KCK", "KLK", "KAK", "KMK", "KSK", "KDK", "KUK", "KHK", "KEK", "KFK" })
+      add<KFK>(code);
+
   add<KNPK>("KNPK");
   add<KNPKB>("KNPKB");
   add<KRPKR>("KRPKR");
@@ -110,6 +113,18 @@ Endgames::Endgames() {
 }
 
 
+/// Endgames::size_bytes() estimates the memory used by the maps, counting for
+/// every entry a tree node of three links and a color plus the functor.
+
+size_t Endgames::size_bytes() const {
+
+  const size_t node = 4 * sizeof(void*);
+
+  return  maps.first.size()  * (node + sizeof(Map<Value>::value_type) + sizeof(EndgameBase<Value>))
+        + maps.second.size() * (node + sizeof(Map<ScaleFactor>::value_type) + sizeof(EndgameBase<ScaleFactor>));
+}
+
+
 /// Mate with KX vs K. This function is used to evaluate positions with
 /// king and plenty of material vs a lone king. It simply gives the
 /// attacking side a bonus for driving the defending king towards the edge
@@ -195,6 +210,46 @@ Value Endgame<KPK>::operator()(const Position& pos) const {
 }
 
 
+/// KF vs K, with F a fairy piece. This endgame is evaluated with the help of
+/// the bitbase of the piece, won positions are scored as in KX vs K to make
+/// progress. Until all gates are used, or while the bitbase is still being
+/// solved after start up, the bitbase does not apply.
+template<>
+Value Endgame<KFK>::operator()(const Position& pos) const {
+
+  assert(pos.count<ALL_PIECES>(strongSide) == 2);
+  assert(verify_material(pos, weakSide, VALUE_ZERO, 0));
+
+  Square wksq = pos.square<KING>(strongSide);
+  Square bksq = pos.square<KING>(weakSide);
+  Square fsq  = lsb(pos.pieces(strongSide) ^ wksq);
+  PieceType pt = type_of(pos.piece_on(fsq));
+
+  Value result =  PieceValue[EG][pt]
+                + PushToEdges[bksq]
+                + PushClose[distance(wksq, bksq)];
+
+  if (!pos.gates() && Bitbases::solved(pt))
+  {
+      if (strongSide == BLACK)
+      {
+          wksq = ~wksq;
+          bksq = ~bksq;
+          fsq  = ~fsq;
+      }
+
+      Color us = strongSide == pos.side_to_move() ? WHITE : BLACK;
+
+      if (!Bitbases::probe(pt, wksq, fsq, bksq, us))
+          return VALUE_DRAW;
+
+      result += VALUE_KNOWN_WIN;
+  }
+
+  return strongSide == pos.side_to_move() ? result : -result;
+}
+
+
 /// KR vs KP. This is a somewhat tricky endgame to evaluate precisely without
 /// a bitbase. The function below returns drawish scores when the pawn is
 /// far advanced with support of the king, while the attacking king is far
@@ -45,6 +45,7 @@ enum EndgameCode {
   KRKN,  // KR vs KN
   KQKP,  // KQ vs KP
   KQKR,  // KQ vs KR
+  KFK,   // KF vs K, with F any fairy piece
 
   SCALING_FUNCTIONS,
   KBPsK,   // KB and pawns vs K
@@ -115,6 +116,7 @@ class Endgames {
 
 public:
   Endgames();
+  size_t size_bytes() const;
 
   template<typename T>
   EndgameBase<T>* probe(Key key) {
@@ -23,6 +23,7 @@
 #include <cstring>   // For std::memset
 #include <iomanip>
 #include <sstream>
+#include <vector>
 
 #include "bitboard.h"
 #include "evaluate.h"
@@ -30,12 +31,16 @@
 #include "pawns.h"
 #include "thread.h"
 
+#if defined(EVAL_PROFILE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h> // For __rdtsc()
+#endif
+
 namespace Trace {
 
-  enum Tracing { NO_TRACE, TRACE };
+  enum Tracing { NO_TRACE, TRACE, PROFILE };
 
   enum Term { // The first PIECE_TYPE_NB entries are reserved for PieceType
-    MATERIAL = PIECE_TYPE_NB, IMBALANCE, MOBILITY, THREAT, PASSED, SPACE, INITIATIVE, TOTAL, TERM_NB
+    MATERIAL = PIECE_TYPE_NB, IMBALANCE, MOBILITY, THREAT, PASSED, SPACE, INITIATIVE, INIT, TOTAL, TERM_NB
   };
 
   Score scores[TERM_NB][COLOR_NB];
@@ -71,8 +76,51 @@ namespace Trace {
 
 using namespace Trace;
 
+namespace Profile {
+
+  // Time spent in each evaluation term, and counters of the evaluations and
+  // of their early exits
+  uint64_t ticks[TERM_NB], calls[TERM_NB], evaluations, specialized, lazyExits;
+
+  template<Tracing T> void count(uint64_t& counter) {
+    if (T == PROFILE)
+        ++counter;
+  }
+
+#ifdef EVAL_PROFILE
+  uint64_t now() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+          (std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+#endif
+}
+
 namespace {
 
+  // Timer adds the time of its scope to a term of the profile. It does nothing
+  // unless the evaluation is profiled.
+  template<Tracing T>
+  struct Timer { explicit Timer(int) {} };
+
+#ifdef EVAL_PROFILE
+  template<>
+  struct Timer<PROFILE> {
+    explicit Timer(int t) : term(t), start(Profile::now()) {}
+    ~Timer() {
+      Profile::ticks[term] += Profile::now() - start;
+      ++Profile::calls[term];
+    }
+
+    int term;
+    uint64_t start;
+  };
+#endif
+
+
   constexpr Bitboard QueenSide   = FileABB | FileBBB | FileCBB | FileDBB;
   constexpr Bitboard CenterFiles = FileCBB | FileDBB | FileEBB | FileFBB;
   constexpr Bitboard KingSide    = FileEBB | FileFBB | FileGBB | FileHBB;
@@ -300,6 +348,8 @@ namespace {
   template<Tracing T> template<Color Us>
   void Evaluation<T>::initialize() {
 
+    Timer<T> timer(INIT);
+
     constexpr Color     Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Direction Up   = (Us == WHITE ? NORTH : SOUTH);
     constexpr Direction Down = (Us == WHITE ? SOUTH : NORTH);
@@ -343,6 +393,8 @@ namespace {
   template<Tracing T> template<Color Us, PieceType Pt>
   Score Evaluation<T>::pieces() {
 
+    Timer<T> timer(Pt);
+
     constexpr Color     Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Direction Down = (Us == WHITE ? SOUTH : NORTH);
     constexpr Bitboard OutpostRanks = (Us == WHITE ? Rank4BB | Rank5BB | Rank6BB
@@ -454,7 +506,7 @@ namespace {
                 score -= WeakQueen;
         }
     }
-    if (T)
+    if (T == TRACE)
         Trace::add(Pt, Us, score);
 
     return score;
@@ -465,6 +517,8 @@ namespace {
   template<Tracing T> template<Color Us>
   Score Evaluation<T>::king() const {
 
+    Timer<T> timer(KING);
+
     constexpr Color    Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Bitboard Camp = (Us == WHITE ? AllSquares ^ Rank6BB ^ Rank7BB ^ Rank8BB
                                            : AllSquares ^ Rank1BB ^ Rank2BB ^ Rank3BB);
@@ -554,7 +608,7 @@ namespace {
     // King tropism, to anticipate slow motion attacks on our king
     score -= CloseEnemies * (popcount(b1) + popcount(b2));
 
-    if (T)
+    if (T == TRACE)
         Trace::add(KING, Us, score);
 
     return score;
@@ -566,6 +620,8 @@ namespace {
   template<Tracing T> template<Color Us>
   Score Evaluation<T>::threats() const {
 
+    Timer<T> timer(THREAT);
+
     constexpr Color     Them     = (Us == WHITE ? BLACK   : WHITE);
     constexpr Direction Up       = (Us == WHITE ? NORTH   : SOUTH);
     constexpr Bitboard  TRank3BB = (Us == WHITE ? Rank3BB : Rank6BB);
@@ -667,7 +723,7 @@ namespace {
     b = (pos.pieces(Us) ^ pos.pieces(Us, PAWN, KING)) & attackedBy[Us][ALL_PIECES];
     score += Connectivity * popcount(b);
 
-    if (T)
+    if (T == TRACE)
         Trace::add(THREAT, Us, score);
 
     return score;
@@ -679,6 +735,8 @@ namespace {
   template<Tracing T> template<Color Us>
   Score Evaluation<T>::passed() const {
 
+    Timer<T> timer(PASSED);
+
     constexpr Color     Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Direction Up   = (Us == WHITE ? NORTH : SOUTH);
 
@@ -760,7 +818,7 @@ namespace {
         score += bonus + PassedFile[file_of(s)];
     }
 
-    if (T)
+    if (T == TRACE)
         Trace::add(PASSED, Us, score);
 
     return score;
@@ -777,6 +835,8 @@ namespace {
   template<Tracing T> template<Color Us>
   Score Evaluation<T>::space() const {
 
+    Timer<T> timer(SPACE);
+
     constexpr Color Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Bitboard SpaceMask =
       Us == WHITE ? CenterFiles & (Rank2BB | Rank3BB | Rank4BB)
@@ -800,7 +860,7 @@ namespace {
 
     Score score = make_score(bonus * weight * weight / 16, 0);
 
-    if (T)
+    if (T == TRACE)
         Trace::add(SPACE, Us, score);
 
     return score;
@@ -833,7 +893,7 @@ namespace {
     // that the endgame score will never change sign after the bonus.
     int v = ((eg > 0) - (eg < 0)) * std::max(complexity, -abs(eg));
 
-    if (T)
+    if (T == TRACE)
         Trace::add(INITIATIVE, make_score(0, v));
 
     return make_score(0, v);
@@ -880,13 +940,21 @@ namespace {
 
     assert(!pos.checkers());
 
+    Timer<T> timer(TOTAL);
+
     // Probe the material hash table
-    me = Material::probe(pos);
+    {
+        Timer<T> probeTimer(MATERIAL);
+        me = Material::probe(pos);
+    }
 
     // If we have a specialized evaluation function for the current material
     // configuration, call it and return.
     if (me->specialized_eval_exists())
+    {
+        Profile::count<T>(Profile::specialized);
         return me->evaluate(pos);
+    }
 
     // Initialize score by reading the incrementally updated scores included in
     // the position object (material + piece square tables) and the material
@@ -894,13 +962,19 @@ namespace {
     Score score = pos.psq_score() + me->imbalance() + pos.this_thread()->contempt;
 
     // Probe the pawn hash table
-    pe = Pawns::probe(pos);
+    {
+        Timer<T> probeTimer(PAWN);
+        pe = Pawns::probe(pos);
+    }
     score += pe->pawn_score(WHITE) - pe->pawn_score(BLACK);
 
     // Early exit if score is high
     Value v = (mg_value(score) + eg_value(score)) / 2;
     if (abs(v) > LazyThreshold)
+    {
+       Profile::count<T>(Profile::lazyExits);
        return pos.side_to_move() == WHITE ? v : -v;
+    }
 
     // Main evaluation begins here
 
@@ -930,6 +1004,8 @@ namespace {
             + passed< WHITE>() - passed< BLACK>()
             + space<  WHITE>() - space<  BLACK>();
 
+    Timer<T> initiativeTimer(INITIATIVE);
+
     score += initiative(eg_value(score));
 
     // Interpolate between a middlegame and a (scaled by 'sf') endgame score
@@ -940,7 +1016,7 @@ namespace {
     v /= int(PHASE_MIDGAME);
 
     // In case of tracing add all remaining individual evaluation terms
-    if (T)
+    if (T == TRACE)
     {
         Trace::add(MATERIAL, pos.psq_score());
         Trace::add(IMBALANCE, me->imbalance());
@@ -1003,3 +1079,105 @@ std::string Eval::trace(const Position& pos) {
 
   return ss.str();
 }
+
+
+#ifdef EVAL_PROFILE
+
+/// profile() evaluates a position the given number of times, adding the time
+/// spent in each term to the profile reported by profile_report().
+
+void Eval::profile(const Position& pos, int iterations) {
+
+  pos.this_thread()->contempt = SCORE_ZERO;
+
+  for (int i = 0; i < iterations; ++i)
+  {
+      ++Profile::evaluations;
+      Evaluation<PROFILE>(pos).value();
+  }
+}
+
+
+/// profile_report() returns the share of the evaluation time of each term and
+/// the frequency of the early exits, then resets the profile.
+
+std::string Eval::profile_report() {
+
+  const char* PieceNames[] = { "", "Pawns", "Knights", "Bishops", "Rooks", "Queens",
+                               "Cannons", "Leopards", "Archbishops", "Chancellors", "Spiders",
+                               "Dragons", "Unicorns", "Hawks", "Elephants", "Fortresses", "King safety" };
+
+  const std::vector<std::pair<int, const char*>> Rows = {
+    { MATERIAL, "Material" }, { PAWN, "Pawns" }, { INIT, "Initialize" },
+    { KNIGHT, nullptr }, { BISHOP, nullptr }, { ROOK, nullptr }, { QUEEN, nullptr },
+    { CANNON, nullptr }, { LEOPARD, nullptr }, { ARCHBISHOP, nullptr }, { CHANCELLOR, nullptr },
+    { SPIDER, nullptr }, { DRAGON, nullptr }, { UNICORN, nullptr }, { HAWK, nullptr },
+    { ELEPHANT, nullptr }, { FORTRESS, nullptr }, { KING, nullptr },
+    { THREAT, "Threats" }, { PASSED, "Passed" }, { SPACE, "Space" }, { INITIATIVE, "Initiative" }
+  };
+
+  // Measure the cost of a timer as seen from inside and from an enclosing
+  // timer, and remove it from the profile.
+  uint64_t saved[] = { Profile::ticks[TOTAL], Profile::calls[TOTAL], Profile::ticks[INIT], Profile::calls[INIT] };
+  const int Samples = 100000;
+
+  Profile::ticks[TOTAL] = Profile::ticks[INIT] = 0;
+  {
+      Timer<PROFILE> outer(TOTAL);
+      for (int i = 0; i < Samples; ++i)
+          Timer<PROFILE> inner(INIT);
+  }
+  double inside = double(Profile::ticks[INIT]) / Samples;
+  double outside = double(Profile::ticks[TOTAL]) / Samples;
+
+  Profile::ticks[TOTAL] = saved[0];
+  Profile::calls[TOTAL] = saved[1];
+  Profile::ticks[INIT]  = saved[2];
+  Profile::calls[INIT]  = saved[3];
+
+  uint64_t innerCalls = 0;
+  for (int t = 0; t < TERM_NB; ++t)
+  {
+      Profile::ticks[t] -= std::min(Profile::ticks[t], uint64_t(inside * Profile::calls[t]));
+      innerCalls += t != TOTAL ? Profile::calls[t] : 0;
+  }
+  Profile::ticks[TOTAL] -= std::min(Profile::ticks[TOTAL], uint64_t(outside * innerCalls));
+
+  uint64_t n = std::max(Profile::evaluations, uint64_t(1));
+  uint64_t total = std::max(Profile::ticks[TOTAL], uint64_t(1)), other = total;
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1)
+     << "        Term |  Share | Ticks/eval\n"
+     << " ------------+--------+-----------\n";
+
+  for (const auto& row : Rows)
+  {
+      uint64_t t = Profile::ticks[row.first];
+      if (!t)
+          continue;
+
+      other -= std::min(other, t);
+      ss << std::setw(12) << (row.second ? row.second : PieceNames[row.first])
+         << " | " << std::setw(5) << 100.0 * t / total
+         << "% | " << std::setw(10) << double(t) / n << "\n";
+  }
+
+  ss << std::setw(12) << "Other"
+     << " | " << std::setw(5) << 100.0 * other / total
+     << "% | " << std::setw(10) << double(other) / n << "\n"
+     << " ------------+--------+-----------\n"
+     << std::setw(12) << "Total"
+     << " | 100.0% | " << std::setw(10) << double(total) / n << "\n"
+     << "\nEvaluations: " << Profile::evaluations
+     << "\nLazy exits : " << Profile::lazyExits << " (" << 100.0 * Profile::lazyExits / n << "%)"
+     << "\nSpecialized: " << Profile::specialized << " (" << 100.0 * Profile::specialized / n << "%)\n";
+
+  std::memset(Profile::ticks, 0, sizeof(Profile::ticks));
+  std::memset(Profile::calls, 0, sizeof(Profile::calls));
+  Profile::evaluations = Profile::specialized = Profile::lazyExits = 0;
+
+  return ss.str();
+}
+
+#endif
@@ -34,6 +34,11 @@ constexpr Value Tempo = Value(20); // Must be visible to search
 
 std::string trace(const Position& pos);
 
+#ifdef EVAL_PROFILE
+void profile(const Position& pos, int iterations);
+std::string profile_report();
+#endif
+
 Value evaluate(const Position& pos);
 }
 
@@ -40,15 +40,16 @@ int main(int argc, char* argv[]) {
   PSQT::init();
   Bitboards::init();
   Position::init();
-  Bitbases::init();
   Search::init();
   Pawns::init();
   Tablebases::init(Options["SyzygyPath"]); // After Bitboards are set
   Threads.set(Options["Threads"]);
   Search::clear(); // After threads are up
+  Bitbases::init(); // After Search::clear(), which waits for the solving
 
   UCI::loop(argc, argv);
 
   Threads.set(0);
+  Bitbases::wait();
   return 0;
 }
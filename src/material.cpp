@@ -19,8 +19,10 @@
 */
 
 #include <algorithm> // For std::min
+#include <atomic>
 #include <cassert>
 #include <cstring>   // For std::memset
+#include <sstream>
 
 #include "material.h"
 #include "thread.h"
@@ -109,113 +111,232 @@ namespace {
     return bonus;
   }
 
+  /// SharedTable is a process-wide material hash table, filled once per material
+  /// configuration and then read by all the threads without locking. Published
+  /// slots are never replaced, so a pointer to an entry stays valid until the
+  /// table is cleared, which is done only while the threads are idle.
+
+  class SharedTable {
+
+    static constexpr size_t Size = 32768;
+    static constexpr int ProbeLimit = 4;
+    static constexpr Key Locked = 1; // Slot claimed, entry being written
+
+    struct Slot {
+      std::atomic<Key> key;
+      Material::Entry entry;
+    };
+
+    Slot table[Size];
+
+  public:
+    void clear() {
+      for (Slot& s : table)
+          s.key.store(0, std::memory_order_relaxed);
+    }
+
+    const Material::Entry* find(Key key) const {
+      for (int i = 0; i < ProbeLimit; ++i)
+      {
+          const Slot& s = table[(uint32_t(key) + i) & (Size - 1)];
+          Key k = s.key.load(std::memory_order_acquire);
+
+          if (k == key)
+              return &s.entry;
+
+          if (!k)
+              break;
+      }
+      return nullptr;
+    }
+
+    void insert(const Material::Entry& e) {
+      for (int i = 0; i < ProbeLimit; ++i)
+      {
+          Slot& s = table[(uint32_t(e.key) + i) & (Size - 1)];
+          Key k = s.key.load(std::memory_order_relaxed);
+
+          if (k == e.key)
+              return;
+
+          if (!k && s.key.compare_exchange_strong(k, Locked, std::memory_order_relaxed))
+          {
+              s.entry = e;
+              s.key.store(e.key, std::memory_order_release);
+              return;
+          }
+      }
+    }
+
+    static constexpr size_t size_bytes() { return Size * sizeof(Slot); }
+  };
+
+  SharedTable Shared;
+  std::atomic<uint64_t> Computed;
+
+  /// compute() fills a material Entry for the position's material configuration
+
+  void compute(const Position& pos, Material::Entry* e) {
+
+    Key key = pos.material_key();
+
+    ++Computed;
+    std::memset(e, 0, sizeof(Material::Entry));
+    e->key = key;
+    e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
+
+    Value npm_w = pos.non_pawn_material(WHITE);
+    Value npm_b = pos.non_pawn_material(BLACK);
+    Value npm = std::max(EndgameLimit, std::min(npm_w + npm_b, MidgameLimit));
+
+    // Map total non-pawn material into [PHASE_ENDGAME, PHASE_MIDGAME]
+    e->gamePhase = Phase(((npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit));
+
+    // Let's look if we have a specialized evaluation function for this particular
+    // material configuration. Firstly we look for a fixed configuration one, then
+    // for a generic one if the previous search failed.
+    if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(key)) != nullptr)
+        return;
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+        if (is_KXK(pos, c))
+        {
+            e->evaluationFunction = &EvaluateKXK[c];
+            return;
+        }
+
+    // OK, we didn't find any special evaluation function for the current material
+    // configuration. Is there a suitable specialized scaling function?
+    EndgameBase<ScaleFactor>* sf;
+
+    if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(key)) != nullptr)
+    {
+        e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
+        return;
+    }
+
+    // We didn't find any specialized scaling function, so fall back on generic
+    // ones that refer to more than one material distribution. Note that in this
+    // case we don't return after setting the function.
+    for (Color c = WHITE; c <= BLACK; ++c)
+    {
+      if (is_KBPsK(pos, c))
+          e->scalingFunction[c] = &ScaleKBPsK[c];
+
+      else if (is_KQKRPs(pos, c))
+          e->scalingFunction[c] = &ScaleKQKRPs[c];
+    }
+
+    if (npm_w + npm_b == VALUE_ZERO && pos.pieces(PAWN)) // Only pawns on the board
+    {
+        if (!pos.count<PAWN>(BLACK))
+        {
+            assert(pos.count<PAWN>(WHITE) >= 2);
+
+            e->scalingFunction[WHITE] = &ScaleKPsK[WHITE];
+        }
+        else if (!pos.count<PAWN>(WHITE))
+        {
+            assert(pos.count<PAWN>(BLACK) >= 2);
+
+            e->scalingFunction[BLACK] = &ScaleKPsK[BLACK];
+        }
+        else if (pos.count<PAWN>(WHITE) == 1 && pos.count<PAWN>(BLACK) == 1)
+        {
+            // This is a special case because we set scaling functions
+            // for both colors instead of only one.
+            e->scalingFunction[WHITE] = &ScaleKPKP[WHITE];
+            e->scalingFunction[BLACK] = &ScaleKPKP[BLACK];
+        }
+    }
+
+    // Zero or just one pawn makes it difficult to win, even with a small material
+    // advantage. This catches some trivial draws like KK, KBK and KNK and gives a
+    // drawish scale factor for cases such as KRKBP and KmmKm (except for KBBKN).
+    if (!pos.count<PAWN>(WHITE) && npm_w - npm_b <= BishopValueMg)
+        e->factor[WHITE] = uint8_t(npm_w <  RookValueMg   ? SCALE_FACTOR_DRAW :
+                                   npm_b <= BishopValueMg ? 4 : 14);
+
+    if (!pos.count<PAWN>(BLACK) && npm_b - npm_w <= BishopValueMg)
+        e->factor[BLACK] = uint8_t(npm_b <  RookValueMg   ? SCALE_FACTOR_DRAW :
+                                   npm_w <= BishopValueMg ? 4 : 14);
+
+    // Evaluate the material imbalance. We use PIECE_TYPE_NONE as a place holder
+    // for the bishop pair "extended piece", which allows us to be more flexible
+    // in defining bishop pair bonuses.
+    const int pieceCount[COLOR_NB][PIECE_TYPE_NB] = {
+    { pos.count<BISHOP>(WHITE) > 1, pos.count<PAWN>(WHITE), pos.count<KNIGHT>(WHITE),
+      pos.count<BISHOP>(WHITE)    , pos.count<ROOK>(WHITE), pos.count<QUEEN >(WHITE) },
+    { pos.count<BISHOP>(BLACK) > 1, pos.count<PAWN>(BLACK), pos.count<KNIGHT>(BLACK),
+      pos.count<BISHOP>(BLACK)    , pos.count<ROOK>(BLACK), pos.count<QUEEN >(BLACK) } };
+
+    e->value = int16_t((imbalance<WHITE>(pieceCount) - imbalance<BLACK>(pieceCount)) / 16);
+  }
+
 } // namespace
 
 namespace Material {
 
-/// Material::probe() looks up the current position's material configuration in
-/// the material hash table. It returns a pointer to the Entry if the position
-/// is found. Otherwise a new Entry is computed and stored there, so we don't
-/// have to recompute all when the same material configuration occurs again.
+bool UseThreadTable = true;
 
-Entry* probe(const Position& pos) {
 
-  Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+/// Material::clear() empties the shared table. It must be called while the
+/// threads are idle, and whenever they are destroyed, because the entries point
+/// to the endgame functions owned by the threads.
 
-  if (e->key == key)
-      return e;
+void clear() {
 
-  std::memset(e, 0, sizeof(Entry));
-  e->key = key;
-  e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
+  Shared.clear();
+  Computed = 0;
+}
 
-  Value npm_w = pos.non_pawn_material(WHITE);
-  Value npm_b = pos.non_pawn_material(BLACK);
-  Value npm = std::max(EndgameLimit, std::min(npm_w + npm_b, MidgameLimit));
 
-  // Map total non-pawn material into [PHASE_ENDGAME, PHASE_MIDGAME]
-  e->gamePhase = Phase(((npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit));
+/// Material::stats() reports the material configurations computed since the
+/// last clear() and the memory taken by the shared and per-thread tables.
 
-  // Let's look if we have a specialized evaluation function for this particular
-  // material configuration. Firstly we look for a fixed configuration one, then
-  // for a generic one if the previous search failed.
-  if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(key)) != nullptr)
-      return e;
+std::string stats() {
 
-  for (Color c = WHITE; c <= BLACK; ++c)
-      if (is_KXK(pos, c))
-      {
-          e->evaluationFunction = &EvaluateKXK[c];
-          return e;
-      }
+  std::stringstream ss;
 
-  // OK, we didn't find any special evaluation function for the current material
-  // configuration. Is there a suitable specialized scaling function?
-  EndgameBase<ScaleFactor>* sf;
+  ss << Computed << " computed, shared table " << Shared.size_bytes() / 1024
+     << " KB + per thread " << Table::size_bytes() / 1024 << " KB x "
+     << Threads.size();
 
-  if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(key)) != nullptr)
-  {
-      e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
+  return ss.str();
+}
+
+
+/// Material::probe() looks up the current position's material configuration in
+/// the thread's material hash table, then in the shared one. It returns a
+/// pointer to the Entry if the position is found. Otherwise a new Entry is
+/// computed, stored in the thread's table and published to the shared one, so
+/// we don't have to recompute all when the same material configuration occurs
+/// again. With UseThreadTable unset the thread's table is only searched for the
+/// configurations that did not fit in the shared one.
+
+Entry* probe(const Position& pos) {
+
+  Key key = pos.material_key();
+  Entry* e = pos.this_thread()->materialTable[key];
+
+  if (UseThreadTable && e->key == key)
       return e;
-  }
 
-  // We didn't find any specialized scaling function, so fall back on generic
-  // ones that refer to more than one material distribution. Note that in this
-  // case we don't return after setting the function.
-  for (Color c = WHITE; c <= BLACK; ++c)
+  if (const Entry* se = Shared.find(key))
   {
-    if (is_KBPsK(pos, c))
-        e->scalingFunction[c] = &ScaleKBPsK[c];
+      if (!UseThreadTable)
+          return const_cast<Entry*>(se);
 
-    else if (is_KQKRPs(pos, c))
-        e->scalingFunction[c] = &ScaleKQKRPs[c];
+      *e = *se;
+      return e;
   }
 
-  if (npm_w + npm_b == VALUE_ZERO && pos.pieces(PAWN)) // Only pawns on the board
+  if (e->key != key)
   {
-      if (!pos.count<PAWN>(BLACK))
-      {
-          assert(pos.count<PAWN>(WHITE) >= 2);
-
-          e->scalingFunction[WHITE] = &ScaleKPsK[WHITE];
-      }
-      else if (!pos.count<PAWN>(WHITE))
-      {
-          assert(pos.count<PAWN>(BLACK) >= 2);
-
-          e->scalingFunction[BLACK] = &ScaleKPsK[BLACK];
-      }
-      else if (pos.count<PAWN>(WHITE) == 1 && pos.count<PAWN>(BLACK) == 1)
-      {
-          // This is a special case because we set scaling functions
-          // for both colors instead of only one.
-          e->scalingFunction[WHITE] = &ScaleKPKP[WHITE];
-          e->scalingFunction[BLACK] = &ScaleKPKP[BLACK];
-      }
+      compute(pos, e);
+      Shared.insert(*e);
   }
 
-  // Zero or just one pawn makes it difficult to win, even with a small material
-  // advantage. This catches some trivial draws like KK, KBK and KNK and gives a
-  // drawish scale factor for cases such as KRKBP and KmmKm (except for KBBKN).
-  if (!pos.count<PAWN>(WHITE) && npm_w - npm_b <= BishopValueMg)
-      e->factor[WHITE] = uint8_t(npm_w <  RookValueMg   ? SCALE_FACTOR_DRAW :
-                                 npm_b <= BishopValueMg ? 4 : 14);
-
-  if (!pos.count<PAWN>(BLACK) && npm_b - npm_w <= BishopValueMg)
-      e->factor[BLACK] = uint8_t(npm_b <  RookValueMg   ? SCALE_FACTOR_DRAW :
-                                 npm_w <= BishopValueMg ? 4 : 14);
-
-  // Evaluate the material imbalance. We use PIECE_TYPE_NONE as a place holder
-  // for the bishop pair "extended piece", which allows us to be more flexible
-  // in defining bishop pair bonuses.
-  const int pieceCount[COLOR_NB][PIECE_TYPE_NB] = {
-  { pos.count<BISHOP>(WHITE) > 1, pos.count<PAWN>(WHITE), pos.count<KNIGHT>(WHITE),
-    pos.count<BISHOP>(WHITE)    , pos.count<ROOK>(WHITE), pos.count<QUEEN >(WHITE) },
-  { pos.count<BISHOP>(BLACK) > 1, pos.count<PAWN>(BLACK), pos.count<KNIGHT>(BLACK),
-    pos.count<BISHOP>(BLACK)    , pos.count<ROOK>(BLACK), pos.count<QUEEN >(BLACK) } };
-
-  e->value = int16_t((imbalance<WHITE>(pieceCount) - imbalance<BLACK>(pieceCount)) / 16);
   return e;
 }
 
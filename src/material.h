@@ -21,6 +21,8 @@
 #ifndef MATERIAL_H_INCLUDED
 #define MATERIAL_H_INCLUDED
 
+#include <string>
+
 #include "endgame.h"
 #include "misc.h"
 #include "position.h"
@@ -66,7 +68,11 @@ struct Entry {
 
 typedef HashTable<Entry, 8192> Table;
 
+extern bool UseThreadTable;
+
 Entry* probe(const Position& pos);
+void clear();
+std::string stats();
 
 } // namespace Material
 
@@ -28,6 +28,7 @@
 #define NOMINMAX
 #endif
 
+#include <malloc.h> // For _aligned_malloc()
 #include <windows.h>
 // The needed Windows API for processor groups could be missed from old Windows
 // versions, so instead of calling them directly (forcing the linker to resolve
@@ -41,6 +42,22 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -216,6 +233,321 @@ void prefetch2(void* addr) {
   prefetch((uint8_t*)addr + 64);
 }
 
+
+/// std_aligned_alloc() allocates size bytes aligned to the given power of two
+/// alignment, which must be a multiple of sizeof(void*). Returns nullptr on
+/// failure. Memory must be released with std_aligned_free().
+
+void* std_aligned_alloc(size_t alignment, size_t size) {
+
+#if defined(_WIN32)
+  return _aligned_malloc(size, alignment);
+#else
+  void* mem;
+  return posix_memalign(&mem, alignment, size) ? nullptr : mem;
+#endif
+}
+
+void std_aligned_free(void* ptr) {
+
+#if defined(_WIN32)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+/// resident_bytes() returns how many bytes of the given range are backed by
+/// physical memory, as reported by mincore(). Where this is not supported the
+/// whole range is assumed to be resident.
+
+size_t resident_bytes(const void* addr, size_t size) {
+
+#ifdef __linux__
+  if (!addr || !size)
+      return 0;
+
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = uintptr_t(addr), end = begin + size;
+  const uintptr_t first = begin & ~(page - 1);
+  vector<unsigned char> pages((end - first + page - 1) / page);
+
+  if (mincore((void*)first, end - first, pages.data()))
+      return size;
+
+  size_t resident = 0;
+  for (size_t i = 0; i < pages.size(); ++i)
+      if (pages[i] & 1)
+      {
+          uintptr_t lo = first + i * page;
+          resident += std::min(end, lo + page) - std::max(begin, lo);
+      }
+
+  return resident;
+#else
+  (void)addr;
+  return size;
+#endif
+}
+
+
+/// process_memory() reads a field such as "VmRSS" or "VmHWM" of the process
+/// status in /proc and returns it in bytes, or 0 if it is not available.
+
+size_t process_memory(const string& field) {
+
+  ifstream status("/proc/self/status");
+  string line;
+
+  while (getline(status, line))
+      if (line.compare(0, field.size() + 1, field + ":") == 0)
+          return size_t(atoll(line.c_str() + field.size() + 1)) * 1024; // In kB
+
+  return 0;
+}
+
+/// available_memory() returns the bytes of physical memory the process could
+/// still allocate: the available memory of the system, bounded on Linux by the
+/// limit of the memory cgroup (v2 or v1) the process runs in. Returns 0 if it
+/// is not known.
+
+size_t available_memory() {
+
+#if defined(_WIN32)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  return GlobalMemoryStatusEx(&status) ? size_t(status.ullAvailPhys) : 0;
+#else
+  // Reads a number from a file, either its first word or the one after a label
+  auto read_bytes = [](const string& fname, const string& label) -> uint64_t {
+      ifstream file(fname);
+      string token;
+      while (file >> token)
+          if (label.empty())
+              return token == "max" ? 0 : uint64_t(atoll(token.c_str()));
+          else if (token == label && file >> token)
+              return uint64_t(atoll(token.c_str())) * 1024; // In kB
+      return 0;
+  };
+
+  uint64_t available = read_bytes("/proc/meminfo", "MemAvailable:");
+
+  const char* cgroups[][2] = {
+      { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current" },
+      { "/sys/fs/cgroup/memory/memory.limit_in_bytes", "/sys/fs/cgroup/memory/memory.usage_in_bytes" } };
+
+  for (const auto& cg : cgroups)
+  {
+      uint64_t limit = read_bytes(cg[0], ""), usage = read_bytes(cg[1], "");
+
+      if (limit)
+          available = std::min(available ? available : limit, limit > usage ? limit - usage : 1); // 0 is unknown
+  }
+
+  return size_t(available);
+#endif
+}
+
+
+/// MappedFile::MappedFile() maps the file read-only. A missing file leaves it
+/// closed, a failed mapping of an existing file is fatal.
+
+MappedFile::MappedFile(const std::string& fname) {
+
+#ifndef _WIN32
+  struct stat statbuf;
+  int fd = ::open(fname.c_str(), O_RDONLY);
+
+  if (fd == -1)
+      return;
+
+  fstat(fd, &statbuf);
+  opened = true;
+  len = size_t(statbuf.st_size);
+
+  if (len)
+  {
+      void* base = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (base == MAP_FAILED)
+      {
+          cerr << "Could not mmap() " << fname << endl;
+          exit(EXIT_FAILURE);
+      }
+
+      ptr = (const char*)base;
+  }
+  ::close(fd);
+#else
+  HANDLE fd = CreateFile(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (fd == INVALID_HANDLE_VALUE)
+      return;
+
+  DWORD sizeHigh;
+  DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+  opened = true;
+  len = size_t((uint64_t(sizeHigh) << 32) | sizeLow);
+
+  if (len)
+  {
+      HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, sizeHigh, sizeLow, nullptr);
+
+      if (!mmap || !(ptr = (const char*)MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0)))
+      {
+          cerr << "Could not map " << fname << ", error = " << GetLastError() << endl;
+          exit(EXIT_FAILURE);
+      }
+
+      mapping = uint64_t(mmap);
+  }
+  CloseHandle(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+
+  if (!ptr)
+      return;
+
+#ifndef _WIN32
+  munmap(const_cast<char*>(ptr), len);
+#else
+  UnmapViewOfFile(ptr);
+  CloseHandle((HANDLE)mapping);
+#endif
+}
+
+
+/// os_thread_id() returns the kernel id of the calling thread on Linux, where
+/// PerfCounters can count the events of any thread of the process, else 0.
+
+int os_thread_id() {
+
+#ifdef __linux__
+  return int(syscall(SYS_gettid));
+#else
+  return 0;
+#endif
+}
+
+
+/// PerfCounters::start() opens and enables a counter of every event for each
+/// thread. An event is counted only if it can be counted in all of them.
+
+void PerfCounters::start() {
+
+#ifdef __linux__
+  constexpr uint64_t Miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  constexpr std::pair<uint32_t, uint64_t> Events[EVENT_NB] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | Miss },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | Miss },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | Miss },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+  };
+
+  std::vector<int> tids = { 0 }; // The calling thread
+
+  for (Thread* th : Threads)
+      tids.push_back(th->osThreadId);
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = Events[e].first;
+      attr.config = Events[e].second;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      for (int tid : tids)
+      {
+          int fd = int(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+          if (fd < 0)
+              break;
+          fds[e].push_back(fd);
+      }
+
+      available[e] = fds[e].size() == tids.size();
+
+      for (int fd : fds[e])
+          if (available[e])
+              ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+          else
+              close(fd);
+
+      if (!available[e])
+          fds[e].clear();
+  }
+#endif
+}
+
+
+/// PerfCounters::stop() reads and closes the counters. When the kernel had to
+/// share the hardware counters between the events, their counts are scaled by
+/// the time they were running.
+
+void PerfCounters::stop() {
+
+#ifdef __linux__
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      for (int fd : fds[e])
+      {
+          uint64_t value[3]; // Count, time enabled, time running
+
+          ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+          if (read(fd, value, sizeof(value)) == sizeof(value) && value[2])
+              counts[e] += uint64_t(double(value[0]) * value[1] / value[2]);
+
+          close(fd);
+      }
+      fds[e].clear();
+  }
+#endif
+}
+
+
+/// PerfCounters::report() returns the counts divided by the given count of
+/// nodes or evaluations, and the instructions per cycle.
+
+std::string PerfCounters::report(uint64_t count, const std::string& unit) const {
+
+  const std::string Names[EVENT_NB] = {
+    "Cycles", "Instr.", "L1D misses", "LLC misses", "dTLB misses", "Br. misses"
+  };
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      ss << "\n" << std::left << std::setw(16) << Names[e] + "/" + unit << ": ";
+
+      if (available[e])
+          ss << double(counts[e]) / std::max(count, uint64_t(1));
+      else
+          ss << "not available";
+  }
+
+  ss << "\n" << std::setw(16) << "IPC" << ": ";
+
+  if (available[CYCLES] && available[INSTRUCTIONS] && counts[CYCLES])
+      ss << double(counts[INSTRUCTIONS]) / counts[CYCLES];
+  else
+      ss << "not available";
+
+  return ss.str();
+}
+
+
 namespace WinProcGroup {
 
 #ifndef _WIN32
@@ -33,6 +33,14 @@ const std::string engine_info(bool to_uci = false);
 void prefetch(void* addr);
 void prefetch2(void* addr);
 void start_logger(const std::string& fname);
+void* std_aligned_alloc(size_t alignment, size_t size);
+void std_aligned_free(void* ptr);
+size_t resident_bytes(const void* addr, size_t size);
+size_t process_memory(const std::string& field);
+size_t available_memory();
+
+constexpr size_t CacheLineSize = 64;
+constexpr size_t PageSize = 4096;
 
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
@@ -51,6 +59,8 @@ inline TimePoint now() {
 template<class Entry, int Size>
 struct HashTable {
   Entry* operator[](Key key) { return &table[(uint32_t)key & (Size - 1)]; }
+  static constexpr size_t size_bytes() { return Size * sizeof(Entry); }
+  size_t resident() const { return resident_bytes(table.data(), size_bytes()); }
 
 private:
   std::vector<Entry> table = std::vector<Entry>(Size);
@@ -101,6 +111,53 @@ public:
 };
 
 
+/// MappedFile maps a whole file read-only in memory, so that large inputs can
+/// be parsed in place without copying them. data() is nullptr when the file
+/// could not be opened and for an empty file.
+
+class MappedFile {
+
+  const char* ptr = nullptr;
+  size_t len = 0;
+  uint64_t mapping = 0;
+  bool opened = false;
+
+public:
+  explicit MappedFile(const std::string& fname);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool is_open() const { return opened; }
+  const char* data() const { return ptr; }
+  size_t size() const { return len; }
+};
+
+
+/// PerfCounters counts hardware events with perf_event_open() on Linux, in the
+/// calling thread and in the search threads, between start() and stop(). The
+/// counts of successive measurements add up. Events which can not be counted,
+/// for lack of permission or on other systems, are reported as such.
+
+class PerfCounters {
+
+  enum Event {
+    CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, EVENT_NB
+  };
+
+  std::vector<int> fds[EVENT_NB];
+  uint64_t counts[EVENT_NB] = {};
+  bool available[EVENT_NB] = {};
+
+public:
+  void start();
+  void stop();
+  std::string report(uint64_t count, const std::string& unit) const;
+};
+
+int os_thread_id();
+
+
 /// Under Windows it is not possible for a process to run on more than one
 /// logical processor group. This usually means to be limited to use max 64
 /// cores. To overcome this, some special platform specific API should be
@@ -38,15 +38,17 @@ namespace {
     Square kfrom = pos.square<KING>(us);
     Square rfrom = pos.castling_rook_square(Cr);
     Square kto = relative_square(us, KingSide ? SQ_G1 : SQ_C1);
-    Bitboard enemies = pos.pieces(~us);
+    Bitboard danger = pos.king_danger();
 
     assert(!pos.checkers());
 
     const Direction step = Chess960 ? kto > kfrom ? WEST : EAST
                                     : KingSide    ? WEST : EAST;
 
+    // Not being in check, the squares crossed by the king are attacked the
+    // same whether the king is seen through or not.
     for (Square s = kto; s != kfrom; s += step)
-        if (pos.attackers_to(s) & enemies)
+        if (danger & s)
             return moveList;
 
     // Because we generate only legal castling moves we need to verify that
@@ -264,8 +266,8 @@ namespace {
     constexpr bool Checks = Type == QUIET_CHECKS;
 
     moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
-    for (PieceType pt = KNIGHT; pt < KING; ++pt)
-        moveList = generate_moves<Checks>(pos, moveList, Us, pt, target);
+    for (const PieceType* pt = pos.piece_types(); *pt != NO_PIECE_TYPE; ++pt)
+        moveList = generate_moves<Checks>(pos, moveList, Us, *pt, target);
 
     if (Type != QUIET_CHECKS && Type != EVASIONS)
     {
@@ -382,20 +384,10 @@ ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 
   Color us = pos.side_to_move();
   Square ksq = pos.square<KING>(us);
-  Bitboard sliderAttacks = 0;
-  Bitboard sliders = pos.checkers();
 
-  // Find all the squares attacked by slider checkers. We will remove them from
-  // the king evasions in order to skip known illegal moves, which avoids any
-  // useless legality checks later on.
-  while (sliders)
-  {
-      Square checksq = pop_lsb(&sliders);
-      sliderAttacks |= attacks_bb(~us, type_of(pos.piece_on(checksq)), checksq, pos.pieces() ^ ksq);
-  }
-
-  // Generate evasions for king, capture and non capture moves
-  Bitboard b = pos.attacks_from<KING>(us, ksq) & ~pos.pieces(us) & ~sliderAttacks;
+  // Generate evasions for king, capture and non capture moves. We skip the
+  // squares attacked by the opponent, so all of them are legal.
+  Bitboard b = pos.attacks_from<KING>(us, ksq) & ~pos.pieces(us) & ~pos.king_danger();
   while (b)
       *moveList++ = make_move(ksq, pop_lsb(&b));
 
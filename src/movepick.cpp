@@ -19,8 +19,11 @@
 */
 
 #include <cassert>
+#include <cstring>   // For std::memset
+#include <sstream>
 
 #include "movepick.h"
+#include "thread.h"
 
 namespace {
 
@@ -52,6 +55,98 @@ namespace {
 } // namespace
 
 
+/// MoveListCache::clear() empties the table and resets the statistics
+
+void MoveListCache::clear() {
+
+  std::memset(table, 0, sizeof(table));
+  probes = hits = 0;
+}
+
+
+/// MoveListCache::generate() fills the move list with the captures or quiets
+/// of the position, copied from the table when they are stored there, and
+/// returns a pointer to the end of the list. Generated captures replace the
+/// entry, while generated quiets are only added to an entry holding the
+/// captures of the same position. Lists too long for an entry are not stored.
+
+template<GenType Type>
+ExtMove* MoveListCache::generate(const Position& pos, ExtMove* moveList) {
+
+  static_assert(Type == CAPTURES || Type == QUIETS, "Wrong type");
+
+  Key key = pos.key();
+  Entry* e = &table[key & (Size - 1)];
+
+  ++probes;
+
+  if (e->key == key && (Type == CAPTURES || e->quiets != NotStored))
+  {
+      const uint16_t* m = e->moves + (Type == CAPTURES ? 0 : e->captures);
+      int n = Type == CAPTURES ? e->captures : e->quiets;
+
+      ++hits;
+      while (n--)
+          *moveList++ = Move(*m++);
+
+      return moveList;
+  }
+
+  ExtMove* end = ::generate<Type>(pos, moveList);
+  int n = int(end - moveList);
+
+  if (Type == CAPTURES && n <= Capacity)
+  {
+      e->key = key;
+      e->captures = uint16_t(n);
+      e->quiets = NotStored;
+  }
+  else if (Type == QUIETS && e->key == key && e->captures + n <= Capacity)
+      e->quiets = uint16_t(n);
+  else
+      return end;
+
+  for (uint16_t* m = e->moves + (Type == CAPTURES ? 0 : e->captures); moveList < end; )
+  {
+      assert(Move(uint16_t(moveList->move)) == moveList->move);
+      *m++ = uint16_t((moveList++)->move);
+  }
+
+  return end;
+}
+
+template ExtMove* MoveListCache::generate<CAPTURES>(const Position&, ExtMove*);
+template ExtMove* MoveListCache::generate<QUIETS>(const Position&, ExtMove*);
+
+
+/// MoveListCache::stats() reports the hit rate of the tables of all threads
+/// since they were last cleared, and the memory they take.
+
+std::string MoveListCache::stats() {
+
+  uint64_t p = 0, h = 0;
+  size_t n = 0;
+
+  for (Thread* th : Threads)
+      if (th->moveListCache)
+      {
+          p += th->moveListCache->probes;
+          h += th->moveListCache->hits;
+          ++n;
+      }
+
+  if (!n)
+      return "off";
+
+  std::stringstream ss;
+
+  ss << h << " hits of " << p << " probes (" << (p ? 100 * h / p : 0)
+     << "%), per thread " << sizeof(table) / 1024 << " KB x " << n;
+
+  return ss.str();
+}
+
+
 /// Constructors of the MovePicker class. As arguments we pass information
 /// to help it to return the (presumably) good moves first, to decide which
 /// moves to return (in the quiescence search, for instance, we only want to
@@ -60,12 +155,16 @@ namespace {
 
 /// MovePicker constructor for the main search
 MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHistory* mh,
-                       const CapturePieceToHistory* cph, const PieceToHistory** ch, Move cm, Move* killers)
+                       const CapturePieceToHistory* cph, const PieceToHistory** ch, Move cm, Move* killers,
+                       MoveListCache* mlc)
            : pos(p), mainHistory(mh), captureHistory(cph), contHistory(ch),
              refutations{{killers[0], 0}, {killers[1], 0}, {cm, 0}}, depth(d) {
 
   assert(d > DEPTH_ZERO);
 
+  if (mlc && d >= MoveListCache::MinDepth)
+      moveListCache = mlc;
+
   stage = pos.checkers() ? EVASION_TT : MAIN_TT;
   ttMove = ttm && pos.pseudo_legal(ttm) ? ttm : MOVE_NONE;
   stage += (ttMove == MOVE_NONE);
@@ -166,7 +265,8 @@ top:
   case PROBCUT_INIT:
   case QCAPTURE_INIT:
       cur = endBadCaptures = moves;
-      endMoves = generate<CAPTURES>(pos, cur);
+      endMoves = moveListCache ? moveListCache->generate<CAPTURES>(pos, cur)
+                               : generate<CAPTURES>(pos, cur);
 
       score<CAPTURES>();
       ++stage;
@@ -201,7 +301,8 @@ top:
 
   case QUIET_INIT:
       cur = endBadCaptures;
-      endMoves = generate<QUIETS>(pos, cur);
+      endMoves = moveListCache ? moveListCache->generate<QUIETS>(pos, cur)
+                               : generate<QUIETS>(pos, cur);
 
       score<QUIETS>();
       partial_insertion_sort(cur, endMoves, -4000 * depth / ONE_PLY);
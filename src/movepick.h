@@ -23,36 +23,64 @@
 
 #include <array>
 #include <limits>
+#include <string>
 #include <type_traits>
 
 #include "movegen.h"
 #include "position.h"
 #include "types.h"
 
+/// HistoryType is the storage type of the history tables. Building with
+/// history=8 halves their size, trading resolution for cache footprint.
+#ifdef HISTORY_INT8
+typedef int8_t HistoryType;
+#else
+typedef int16_t HistoryType;
+#endif
+
 /// StatsEntry stores the stat table value. It is usually a number but could
 /// be a move or even a nested history. We use a class instead of naked value
 /// to directly call history update operator<<() on the entry so to use stats
-/// tables at caller sites as simple multi-dim arrays.
+/// tables at caller sites as simple multi-dim arrays. When D does not fit in T
+/// the entry is stored in units of Scale, so that callers always see [-D, D].
 template<typename T, int D>
 class StatsEntry {
 
   static const bool IsInt = std::is_integral<T>::value;
   typedef typename std::conditional<IsInt, int, T>::type TT;
 
+  static constexpr int Max = std::numeric_limits<typename std::conditional<IsInt, T, int>::type>::max();
+  static constexpr int Scale = IsInt && D > Max ? (D + Max - 1) / Max : 1;
+
   T entry;
 
+  TT value(std::true_type) const { return entry * Scale; }
+  TT value(std::false_type) const { return entry; }
+
 public:
   T* get() { return &entry; }
   void operator=(const T& v) { entry = v; }
-  operator TT() const { return entry; }
+  operator TT() const { return value(std::integral_constant<bool, IsInt>()); }
 
   void operator<<(int bonus) {
     assert(abs(bonus) <= D);   // Ensure range is [-D, D]
-    static_assert(D <= std::numeric_limits<T>::max(), "D overflows T");
-
-    entry += bonus - entry * abs(bonus) / D;
-
-    assert(abs(entry) <= D);
+    static_assert(D <= std::numeric_limits<T>::max() * Scale, "D overflows T");
+
+    if (Scale == 1)
+        entry += bonus - entry * abs(bonus) / D;
+    else
+    {
+        // Update in full resolution and round to the nearest step, but always
+        // move at least one step so that small bonuses are not lost.
+        int v = entry * Scale;
+        v += bonus - v * abs(bonus) / D;
+        int e = (v + (v < 0 ? -Scale : Scale) / 2) / Scale;
+        if (e == entry && v != entry * Scale)
+            e += v > entry * Scale ? 1 : -1;
+        entry = T(std::max(-Max, std::min(e, int(Max))));
+    }
+
+    assert(abs(int(*this)) < D + Scale);
   }
 };
 
@@ -80,27 +108,76 @@ struct Stats<T, D, Size> : public std::array<StatsEntry<T, D>, Size> {
 /// In stats table, D=0 means that the template parameter is not used
 enum StatsParams { NOT_USED = 0 };
 
+/// Piece codes use only KING + 1 of the PIECE_TYPE_NB values of each color, so
+/// the piece dimension of the larger tables is packed with piece_slot().
+/// PieceStats wraps such a table and takes a Piece as first index.
+constexpr int PIECE_SLOT_NB = 2 * (KING + 1);
+
+constexpr int piece_slot(Piece pc) {
+  return (pc >> PIECE_TYPE_BITS) * (KING + 1) + type_of(pc);
+}
+
+template <typename S>
+struct PieceStats : public S {
+  typename S::reference operator[](Piece pc) { return S::operator[](piece_slot(pc)); }
+  typename S::const_reference operator[](Piece pc) const { return S::operator[](piece_slot(pc)); }
+};
+
 
 /// ButterflyHistory records how often quiet moves have been successful or
 /// unsuccessful during the current search, and is used for reduction and move
 /// ordering decisions. It uses 2 tables (one for each color) indexed by
 /// the move's from and to squares, see chessprogramming.wikispaces.com/Butterfly+Boards
-typedef Stats<int16_t, 10368, COLOR_NB, int(SQUARE_NB) * int(SQUARE_NB)> ButterflyHistory;
+typedef Stats<HistoryType, 10368, COLOR_NB, int(SQUARE_NB) * int(SQUARE_NB)> ButterflyHistory;
 
 /// CounterMoveHistory stores counter moves indexed by [piece][to] of the previous
 /// move, see chessprogramming.wikispaces.com/Countermove+Heuristic
 typedef Stats<Move, NOT_USED, PIECE_NB, SQUARE_NB> CounterMoveHistory;
 
 /// CapturePieceToHistory is addressed by a move's [piece][to][captured piece type]
-typedef Stats<int16_t, 10368, PIECE_NB, SQUARE_NB, PIECE_TYPE_NB> CapturePieceToHistory;
+typedef PieceStats<Stats<HistoryType, 10368, PIECE_SLOT_NB, SQUARE_NB, PIECE_TYPE_NB>> CapturePieceToHistory;
 
 /// PieceToHistory is like ButterflyHistory but is addressed by a move's [piece][to]
-typedef Stats<int16_t, 29952, PIECE_NB, SQUARE_NB> PieceToHistory;
+typedef PieceStats<Stats<HistoryType, 29952, PIECE_SLOT_NB, SQUARE_NB>> PieceToHistory;
 
 /// ContinuationHistory is the combined history of a given pair of moves, usually
 /// the current one given a previous one. The nested history table is based on
 /// PieceToHistory instead of ButterflyBoards.
-typedef Stats<PieceToHistory, NOT_USED, PIECE_NB, SQUARE_NB> ContinuationHistory;
+typedef PieceStats<Stats<PieceToHistory, NOT_USED, PIECE_SLOT_NB, SQUARE_NB>> ContinuationHistory;
+
+
+/// MoveListCache is a small per-thread hash table of the pseudo legal captures
+/// and quiets generated at the interior nodes of the main search, indexed by
+/// position key. Iterative deepening visits these nodes again at every depth,
+/// and MovePicker then copies the stored moves instead of generating them. The
+/// quiets are stored separately, after the captures, because many nodes are
+/// cut off before they are needed. Moves fit in 16 bits. A stored list holds
+/// the same moves as a generated one, but possibly in another order because
+/// the piece lists depend on the move history, so enabling the cache changes
+/// the search.
+class MoveListCache {
+
+  static constexpr int Size = 2048;
+  static constexpr int Capacity = 122; // Moves per entry, for 256-byte entries
+  static constexpr uint16_t NotStored = 0xFFFF;
+
+  struct Entry {
+    Key key;
+    uint16_t captures, quiets;
+    uint16_t moves[Capacity];
+  };
+
+  Entry table[Size];
+  uint64_t probes, hits;
+
+public:
+  static constexpr Depth MinDepth = 6 * ONE_PLY;
+
+  template<GenType> ExtMove* generate(const Position& pos, ExtMove* moveList);
+  void clear();
+
+  static std::string stats();
+};
 
 
 /// MovePicker class is used to pick one pseudo legal move at a time from the
@@ -124,7 +201,8 @@ public:
                                            const CapturePieceToHistory*,
                                            const PieceToHistory**,
                                            Move,
-                                           Move*);
+                                           Move*,
+                                           MoveListCache*);
   Move next_move(bool skipQuiets = false);
 
 private:
@@ -137,6 +215,7 @@ private:
   const ButterflyHistory* mainHistory;
   const CapturePieceToHistory* captureHistory;
   const PieceToHistory** contHistory;
+  MoveListCache* moveListCache = nullptr;
   Move ttMove;
   ExtMove refutations[3], *cur, *endMoves, *endBadCaptures;
   int stage;
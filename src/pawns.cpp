@@ -68,6 +68,100 @@ namespace {
   template<Color Us>
   Score evaluate(const Position& pos, Pawns::Entry* e) {
 
+    constexpr Color     Them     = (Us == WHITE ? BLACK : WHITE);
+    constexpr Direction Up       = (Us == WHITE ? NORTH : SOUTH);
+    constexpr Direction Down     = (Us == WHITE ? SOUTH : NORTH);
+    constexpr Bitboard  FarRanks = (Us == WHITE ? Rank5BB | Rank6BB | Rank7BB
+                                                : Rank4BB | Rank3BB | Rank2BB);
+
+    Bitboard b, supported;
+    Square s;
+    Score score = SCORE_ZERO;
+
+    Bitboard ourPawns   = pos.pieces(  Us, PAWN);
+    Bitboard theirPawns = pos.pieces(Them, PAWN);
+
+    // All the features are computed at once as the sets of our pawns having
+    // them. The 'A' and 'B' sets refer to the two adjacent files, so that a
+    // pawn in both has the feature twice.
+    Bitboard ourW = shift<WEST>(ourPawns), ourE = shift<EAST>(ourPawns);
+    Bitboard theirW = shift<WEST>(theirPawns), theirE = shift<EAST>(theirPawns);
+
+    Bitboard ourFiles  = fill<NORTH>(fill<SOUTH>(ourPawns));
+    Bitboard opposed   = fill<Down>(shift<Down>(theirPawns));
+    Bitboard ownAhead  = fill<Down>(shift<Down>(ourPawns));
+    Bitboard farAdj    = shift<Down>(shift<Down>(shift<Down>(fill<Down>(theirW | theirE))));
+    Bitboard neighbours = shift<WEST>(ourFiles) | shift<EAST>(ourFiles);
+
+    Bitboard leverA = shift<Down>(theirW), leverB = shift<Down>(theirE);
+    Bitboard pushA  = shift<Down>(leverA), pushB  = shift<Down>(leverB);
+    Bitboard supA   = shift<Up>(ourW),     supB   = shift<Up>(ourE);
+    Bitboard phalanx = ourW | ourE, support = supA | supB;
+
+    e->passedPawns[Us] = e->weakUnopposed[Us] = 0;
+    e->semiopenFiles[Us] = int(~ourFiles & 0xFF);
+    e->kingSquares[Us]   = SQ_NONE;
+    e->pawnAttacks[Us]   = pawn_attacks_bb<Us>(ourPawns);
+    e->pawnAttacksSpan[Us] = pawn_attacks_bb<Us>(fill<Up>(ourPawns));
+    e->pawnsOnSquares[Us][BLACK] = popcount(ourPawns & DarkSquares);
+    e->pawnsOnSquares[Us][WHITE] = pos.count<PAWN>(Us) - e->pawnsOnSquares[Us][BLACK];
+
+    // A pawn is backward when it is behind all pawns of the same color on the
+    // adjacent files and cannot be safely advanced.
+    Bitboard backward =  ~fill<Up>(phalanx)
+                       & shift<Down>(theirPawns | pawn_attacks_bb<Them>(theirPawns));
+
+    // Passed pawns will be properly scored in evaluation because we need
+    // full attack info to evaluate them. Include also not passed pawns
+    // which could become passed after one or two pawn pushes when are
+    // not attacked more times than defended: the only stoppers are levers,
+    // there are not two levers without support, and no more lever pushes
+    // than phalanx pawns.
+    e->passedPawns[Us] =  ourPawns & ~opposed & ~farAdj & ~ownAhead
+                        & ~(leverA & leverB & ~support)
+                        & ~(pushA & pushB & ~(ourW & ourE))
+                        & ~((pushA | pushB) & ~phalanx);
+
+    // A pawn on the fifth rank or beyond, blocked only by the pawn in front,
+    // is also passed if a supporting pawn can advance to lever it safely.
+    b = ourPawns & FarRanks & shift<Down>(theirPawns) & ~e->passedPawns[Us];
+    while (b)
+    {
+        s = pop_lsb(&b);
+
+        if ((theirPawns & passed_pawn_mask(Us, s)) != SquareBB[s + Up])
+            continue;
+
+        supported = shift<Up>(ourPawns & adjacent_files_bb(file_of(s)) & rank_bb(s - Up)) & ~theirPawns;
+        while (supported)
+            if (!more_than_one(theirPawns & PseudoAttacks[Us][PAWN][pop_lsb(&supported)]))
+                e->passedPawns[Us] |= s;
+    }
+
+    // Score the pawns
+    Bitboard connected = ourPawns & (support | phalanx);
+    Bitboard isolated  = ourPawns & ~connected & ~neighbours;
+    Bitboard weak      = isolated | (ourPawns & ~connected & neighbours & backward);
+
+    for (b = connected; b; )
+    {
+        s = pop_lsb(&b);
+        score += Connected[bool(opposed & s)][bool(phalanx & s)][bool(supA & s) + bool(supB & s)][relative_rank(Us, s)];
+    }
+
+    score -= Isolated * popcount(isolated) + Backward * popcount(weak ^ isolated);
+    score -= Doubled * popcount(ourPawns & shift<Up>(ourPawns) & ~support);
+    e->weakUnopposed[Us] = popcount(weak & ~opposed);
+
+    return score;
+  }
+
+#ifndef NDEBUG
+  // evaluate_reference() is the pawn by pawn version of evaluate(), used to
+  // check in debug builds that both give the same entry.
+  template<Color Us>
+  Score evaluate_reference(const Position& pos, Pawns::Entry* e) {
+
     constexpr Color     Them = (Us == WHITE ? BLACK : WHITE);
     constexpr Direction Up   = (Us == WHITE ? NORTH : SOUTH);
 
@@ -149,6 +243,8 @@ namespace {
     return score;
   }
 
+#endif
+
 } // namespace
 
 namespace Pawns {
@@ -190,6 +286,20 @@ Entry* probe(const Position& pos) {
   e->key = key;
   e->scores[WHITE] = evaluate<WHITE>(pos, e);
   e->scores[BLACK] = evaluate<BLACK>(pos, e);
+
+#ifndef NDEBUG
+  Entry ref = *e;
+  for (Color c = WHITE; c <= BLACK; ++c)
+  {
+      ref.scores[c] = c == WHITE ? evaluate_reference<WHITE>(pos, &ref)
+                                 : evaluate_reference<BLACK>(pos, &ref);
+      assert(   ref.scores[c] == e->scores[c]
+             && ref.passedPawns[c] == e->passedPawns[c]
+             && ref.pawnAttacksSpan[c] == e->pawnAttacksSpan[c]
+             && ref.weakUnopposed[c] == e->weakUnopposed[c]
+             && ref.semiopenFiles[c] == e->semiopenFiles[c]);
+  }
+#endif
   e->openFiles = popcount(e->semiopenFiles[WHITE] & e->semiopenFiles[BLACK]);
   e->asymmetry = popcount(  (e->passedPawns[WHITE]   | e->passedPawns[BLACK])
                           | (e->semiopenFiles[WHITE] ^ e->semiopenFiles[BLACK]));
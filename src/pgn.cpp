@@ -0,0 +1,503 @@
+/*
+  Musketeer-Stockfish, a UCI chess variant playing engine derived from Stockfish
+  Copyright (C) 2018-2020 Fabian Fichter
+
+  Musketeer-Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Musketeer-Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "pgn.h"
+#include "position.h"
+#include "thread.h"
+#include "uci.h"
+
+namespace {
+
+  const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  // Piece type of an uppercase SAN piece letter, NO_PIECE_TYPE if none
+  PieceType piece_type(char c) {
+
+    size_t idx = c != ' ' ? PieceToChar.find(c) : std::string::npos;
+    return idx != std::string::npos && idx <= KING ? PieceType(idx) : NO_PIECE_TYPE;
+  }
+
+  bool is_file(char c) { return c >= 'a' && c <= 'h'; }
+  bool is_rank(char c) { return c >= '1' && c <= '8'; }
+
+  Move legal_move(const Position& pos, Move m) {
+    return pos.pseudo_legal(m) && pos.legal(m) ? m : MOVE_NONE;
+  }
+
+
+  // game_start() returns the start of the first game after p, that is the first
+  // tag line following a blank line, or p itself at the start of the file.
+  // Every reading thread takes the games between two such boundaries.
+
+  const char* game_start(const char* data, const char* p, const char* end) {
+
+    if (p == data)
+        return p;
+
+    bool blank = false;
+
+    for (p = std::find(p, end, '\n'); p < end; )
+    {
+        const char* line = ++p;
+
+        if (line < end && *line == '[' && blank)
+            return line;
+
+        p = std::find(line, end, '\n');
+        blank = std::all_of(line, p, [](char c) { return isspace(c); });
+    }
+
+    return end;
+  }
+
+
+  // skip_variation() returns the end of the variation starting at p, which may
+  // contain comments and nested variations.
+
+  const char* skip_variation(const char* p, const char* end) {
+
+    for (int depth = 0; p < end; ++p)
+        if (*p == '{')
+        {
+            if ((p = std::find(p, end, '}')) == end)
+                break;
+        }
+        else if (*p == '(')
+            ++depth;
+        else if (*p == ')' && !--depth)
+            return p + 1;
+
+    return end;
+  }
+
+
+  // parse() reads the games between p and end, replaying their moves, and
+  // passes each one to the handler. It returns the number of games read. The
+  // positions are bound to a search thread, which must be idle.
+
+  uint64_t parse(const char* p, const char* end, size_t idx, const PGN::GameHandler& handler) {
+
+    Position pos;
+    std::deque<StateInfo> states(1);
+    PGN::Game game;
+    bool inGame = false, inMoves = false;
+    uint64_t games = 0;
+
+    auto finish = [&]() {
+        if (inGame)
+        {
+            handler(idx, game);
+            ++games;
+        }
+        game.fen = StartFEN;
+        game.result.clear();
+        game.moves.clear();
+        game.chess960 = game.error = inGame = inMoves = false;
+    };
+
+    finish();
+
+    while (p < end)
+    {
+        if (isspace(*p))
+        {
+            ++p;
+            continue;
+        }
+
+        const char* eol = std::find(p, end, '\n');
+
+        switch (*p) {
+
+        case '[': // Tag pair, like [FEN "..."]
+        {
+            if (inMoves)
+                finish();
+
+            const char* name = p + 1;
+            const char* nameEnd = std::find(name, eol, ' ');
+            const char* value = std::find(nameEnd, eol, '"') + 1;
+            const char* valueEnd = value;
+
+            for (const char* q = value; q < eol; ++q)
+                if (*q == '"')
+                    valueEnd = q;
+
+            if (value < valueEnd && std::string(name, nameEnd) == "FEN")
+                game.fen.assign(value, valueEnd);
+            else if (value < valueEnd && std::string(name, nameEnd) == "Result")
+                game.result.assign(value, valueEnd);
+            else if (value < valueEnd && std::string(name, nameEnd) == "Variant")
+                game.chess960 = std::search(value, valueEnd, "960", "960" + 3) != valueEnd;
+
+            inGame = true;
+            p = eol;
+            continue;
+        }
+
+        case '{': // Comment
+            p = std::find(p, end, '}');
+            p += p < end;
+            continue;
+
+        case ';': // Rest of line comment
+        case '%': // Escaped line
+            p = eol;
+            continue;
+
+        case '(': // Variation
+            p = skip_variation(p, end);
+            continue;
+
+        case ')':
+            ++p;
+            continue;
+
+        case '$': // Numeric annotation glyph
+            while (++p < end && isdigit(*p)) {}
+            continue;
+        }
+
+        const char* t = p;
+        while (p < end && !isspace(*p) && !strchr("{}();[", *p))
+            ++p;
+
+        std::string token(t, p);
+
+        // Game termination marker
+        if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*")
+        {
+            if (game.result.empty())
+                game.result = token;
+
+            inGame = true;
+            finish();
+            continue;
+        }
+
+        // Move number, like "12." or "12...", possibly followed by the move
+        if (isdigit(*t) && token.compare(0, 3, "0-0"))
+        {
+            while (t < p && isdigit(*t))
+                ++t;
+            while (t < p && *t == '.')
+                ++t;
+            if (t == p)
+                continue;
+        }
+
+        if (!inMoves)
+        {
+            states.resize(1);
+            pos.set(game.fen, game.chess960, &states.back(), Threads[idx]);
+            inGame = inMoves = true;
+        }
+
+        if (game.error)
+            continue;
+
+        Move m = PGN::san_to_move(pos, t, p);
+
+        if (m == MOVE_NONE)
+        {
+            game.error = true;
+            continue;
+        }
+
+        states.emplace_back();
+        pos.do_move(m, states.back());
+        game.moves.push_back(m);
+    }
+
+    finish();
+    return games;
+  }
+
+} // namespace
+
+
+/// PGN::san() converts a move to Standard Algebraic Notation. The selection
+/// and placement of the gating pieces are written as in UCI notation, and the
+/// piece entering the board with a move from a gate is appended after a slash,
+/// like "Nf3/H". The move is made to find out whether it mates.
+
+std::string PGN::san(Position& pos, Move m) {
+
+  if (m == MOVE_NONE)
+      return "(none)";
+
+  if (m == MOVE_NULL)
+      return "--";
+
+  if (type_of(m) == SET_GATING_TYPE || type_of(m) == PUT_GATING_PIECE)
+      return UCI::move(m, pos);
+
+  Color us = pos.side_to_move();
+  Square from = from_sq(m), to = to_sq(m);
+  PieceType pt = type_of(pos.moved_piece(m));
+  std::string san;
+
+  if (type_of(m) == CASTLING)
+      san = to > from ? "O-O" : "O-O-O";
+
+  else if (pt == PAWN)
+  {
+      if (pos.capture(m))
+          san = std::string{char('a' + file_of(from)), 'x'};
+
+      san += UCI::square(to);
+
+      if (type_of(m) == PROMOTION)
+          san += std::string{'=', PieceToChar[promotion_type(m)]};
+  }
+  else
+  {
+      san = PieceToChar[pt];
+
+      // Disambiguate with the file, the rank or both, in that order
+      Bitboard others = 0, b = pos.pieces(us, pt) ^ from;
+
+      while (b)
+      {
+          Square s = pop_lsb(&b);
+          if (   (pos.attacks_from(us, pt, s) & to)
+              && legal_move(pos, make_move(s, to)))
+              others |= s;
+      }
+
+      if (others && (!(others & file_bb(from)) || (others & rank_bb(from))))
+          san += char('a' + file_of(from));
+
+      if (others & file_bb(from))
+          san += char('1' + rank_of(from));
+
+      if (pos.capture(m))
+          san += 'x';
+
+      san += UCI::square(to);
+  }
+
+  if (type_of(m) != CASTLING && (pos.gates() & from))
+      san += std::string{'/', PieceToChar[pos.gating_piece(from)]};
+
+  if (pos.gives_check(m))
+  {
+      StateInfo st;
+
+      pos.do_move(m, st, true);
+      san += MoveList<LEGAL>(pos).size() ? '+' : '#';
+      pos.undo_move(m);
+  }
+
+  return san;
+}
+
+
+/// PGN::san_to_move() converts a move in Standard Algebraic Notation to the
+/// corresponding legal move, if any. The origin of the move is found with the
+/// attack tables of the pieces that can reach the destination, so no move list
+/// is generated outside of the setup phase. Long algebraic notation, like
+/// "Ng1-f3", and an optional gating suffix, like "Ng1f3/H", are accepted.
+
+Move PGN::san_to_move(const Position& pos, const char* b, const char* e) {
+
+  // Strip check, mate and annotation symbols
+  while (e > b && strchr("+#!?", e[-1]))
+      --e;
+
+  if (b == e)
+      return MOVE_NONE;
+
+  Color us = pos.side_to_move();
+  std::string str(b, e);
+
+  // Gating piece selection and placement are written as in UCI notation, with
+  // an optional back rank number instead of 0 or 9, like "H@b1".
+  if (pos.game_phase() != GAMEPHASE_PLAYING)
+  {
+      if (str.size() == 4 && str[1] == '@' && (str[3] == '1' || str[3] == '8'))
+          str[3] = str[3] == '1' ? '0' : '9';
+
+      for (const auto& m : MoveList<LEGAL>(pos))
+          if (str == UCI::move(m, pos))
+              return m;
+
+      return MOVE_NONE;
+  }
+
+  if (*b == 'O' || *b == '0')
+  {
+      bool kingSide = str == "O-O" || str == "0-0";
+
+      if (!kingSide && str != "O-O-O" && str != "0-0-0")
+          return MOVE_NONE;
+
+      CastlingRight cr = us | (kingSide ? KING_SIDE : QUEEN_SIDE);
+
+      return pos.can_castle(cr) ? legal_move(pos, make<CASTLING>(pos.square<KING>(us),
+                                                                 pos.castling_rook_square(cr)))
+                                : MOVE_NONE;
+  }
+
+  PieceType pt = PAWN, promotion = NO_PIECE_TYPE, gating = NO_PIECE_TYPE;
+
+  if (e - b > 2 && e[-2] == '/')
+  {
+      if (!(gating = piece_type(e[-1])))
+          return MOVE_NONE;
+      e -= 2;
+  }
+
+  if (isupper(*b) && !(pt = piece_type(*b++)))
+      return MOVE_NONE;
+
+  if (e - b > 2 && isupper(e[-1]))
+  {
+      if (!(promotion = piece_type(*--e)))
+          return MOVE_NONE;
+      e -= e[-1] == '=';
+  }
+
+  if (e - b < 2 || !is_file(e[-2]) || !is_rank(e[-1]))
+      return MOVE_NONE;
+
+  Square to = make_square(File(e[-2] - 'a'), Rank(e[-1] - '1'));
+  e -= 2;
+
+  if (e > b && (e[-1] == 'x' || e[-1] == '-' || e[-1] == ':'))
+      --e;
+
+  // Origin square, fully or partially given
+  Bitboard from = AllSquares;
+
+  for ( ; b < e; ++b)
+      if (is_file(*b))
+          from &= file_bb(File(*b - 'a'));
+      else if (is_rank(*b))
+          from &= rank_bb(Rank(*b - '1'));
+      else
+          return MOVE_NONE;
+
+  Move m = MOVE_NONE;
+
+  if (pt == PAWN)
+  {
+      Direction up = pawn_push(us);
+
+      if (relative_rank(us, to) == RANK_1)
+          return MOVE_NONE;
+
+      Square s = to - up;
+
+      if (!(from & file_bb(to)))
+          s = make_square(file_of(lsb(from)), rank_of(s));
+
+      else if (   relative_rank(us, to) == RANK_4
+               && pos.empty(s)
+               && pos.piece_on(s - up) == make_piece(us, PAWN))
+          s -= up;
+
+      if (!(from & s) || pos.piece_on(s) != make_piece(us, PAWN))
+          return MOVE_NONE;
+
+      m =  promotion && file_of(s) == file_of(to) ? make<PROMOTION_STRAIGHT>(s, to, promotion)
+         : promotion && s == to - up - WEST       ? make<PROMOTION_LEFT>(s, to, promotion)
+         : promotion                              ? make<PROMOTION_RIGHT>(s, to, promotion)
+         : to == pos.ep_square() && file_of(s) != file_of(to) ? make<ENPASSANT>(s, to)
+                                                  : make_move(s, to);
+      m = legal_move(pos, m);
+  }
+  else if (!promotion)
+  {
+      Bitboard candidates = pos.pieces(us, pt) & from;
+
+      while (candidates)
+      {
+          Square s = pop_lsb(&candidates);
+
+          if (   (pos.attacks_from(us, pt, s) & to)
+              && legal_move(pos, make_move(s, to)))
+          {
+              if (m)
+                  return MOVE_NONE; // Ambiguous
+
+              m = make_move(s, to);
+          }
+      }
+  }
+
+  if (   m
+      && gating
+      && (!(pos.gates() & from_sq(m)) || pos.gating_piece(from_sq(m)) != gating))
+      return MOVE_NONE;
+
+  return m;
+}
+
+
+/// PGN::read() reads the games of a PGN file, mapped in memory, with the given
+/// number of threads, at most one per search thread. The file is split at game
+/// boundaries into one part per thread, and every thread replays the games of
+/// its part, passing each one to the handler. The search threads must be idle.
+/// It returns the number of games read, 0 if the file can not be opened.
+
+uint64_t PGN::read(const std::string& fname, size_t threadCount, const GameHandler& handler) {
+
+  MappedFile file(fname);
+
+  if (!file.is_open())
+  {
+      std::cerr << "Unable to open file " << fname << std::endl;
+      return 0;
+  }
+
+  const char* data = file.data();
+  const char* end = data + file.size();
+  std::vector<const char*> bounds;
+  std::vector<std::thread> threads;
+  std::atomic<uint64_t> games(0);
+
+  // Every reading thread needs a search thread of its own for its positions
+  threadCount = std::max(std::min(threadCount, Threads.size()), size_t(1));
+
+  for (size_t i = 0; i < threadCount; ++i)
+      bounds.push_back(game_start(data, data + i * file.size() / threadCount, end));
+
+  bounds.push_back(end);
+
+  for (size_t idx = 0; idx < threadCount; ++idx)
+      threads.push_back(std::thread([&, idx]() {
+          games += parse(bounds[idx], bounds[idx + 1], idx, handler);
+      }));
+
+  for (std::thread& th : threads)
+      th.join();
+
+  return games;
+}
@@ -0,0 +1,57 @@
+/*
+  Musketeer-Stockfish, a UCI chess variant playing engine derived from Stockfish
+  Copyright (C) 2018-2020 Fabian Fichter
+
+  Musketeer-Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Musketeer-Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PGN_H_INCLUDED
+#define PGN_H_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+class Position;
+
+namespace PGN {
+
+/// Game holds a game read from a PGN file: its starting position, taken from
+/// the FEN tag if any, its result tag and its moves. A Variant tag naming
+/// Chess960 sets 'chess960'. When a move can not be read, the moves before it
+/// are kept and 'error' is set.
+
+struct Game {
+  std::string fen;
+  std::string result;
+  std::vector<Move> moves;
+  bool chess960 = false;
+  bool error = false;
+};
+
+/// A GameHandler is called for every game read, with the index of the reading
+/// thread. It is called concurrently by the reading threads.
+
+typedef std::function<void(size_t, const Game&)> GameHandler;
+
+std::string san(Position& pos, Move m);
+Move san_to_move(const Position& pos, const char* begin, const char* end);
+uint64_t read(const std::string& fname, size_t threadCount, const GameHandler& handler);
+
+} // namespace PGN
+
+#endif // #ifndef PGN_H_INCLUDED
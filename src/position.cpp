@@ -39,6 +39,7 @@ using std::string;
 namespace PSQT {
   extern Score psq[PIECE_NB][SQUARE_NB];
   extern Score psq_gate[PIECE_NB][FILE_NB];
+  extern Score psq_gated[PIECE_NB][FILE_NB];
 }
 
 namespace Zobrist {
@@ -104,7 +105,8 @@ std::ostream& operator<<(std::ostream& os, const Position& pos) {
       os << " |\n +---+---+---+---+---+---+---+---+\n";
   }
 
-  os << "\nFen: " << pos.fen() << "\nKey: " << std::hex << std::uppercase
+  os << "\nFen: " << pos.fen() << "\nPacked: " << pos.pack().hex()
+     << "\nKey: " << std::hex << std::uppercase
      << std::setfill('0') << std::setw(16) << pos.key()
      << std::setfill(' ') << std::dec << "\nCheckers: ";
 
@@ -397,6 +399,7 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si, Th
 
   chess960 = isChess960;
   thisThread = th;
+  set_piece_types();
   set_state(st);
 
   assert(pos_is_ok());
@@ -429,6 +432,28 @@ void Position::set_castling_right(Color c, Square rfrom) {
   for (Square s = std::min(kfrom, kto); s <= std::max(kfrom, kto); ++s)
       if (s != kfrom && s != rfrom)
           castlingPath[cr] |= s;
+
+  castlingPsq[cr] =  PSQT::psq[make_piece(c, KING)][kto] - PSQT::psq[make_piece(c, KING)][kfrom]
+                   + PSQT::psq[make_piece(c, ROOK)][rto] - PSQT::psq[make_piece(c, ROOK)][rfrom];
+}
+
+
+/// Position::set_piece_types() lists the non-pawn piece types other than the
+/// king which can be on the board: the standard ones, the gating types chosen
+/// so far and any other type given by the FEN. Move generation and attack
+/// detection loop over this list instead of over all the fairy types.
+
+void Position::set_piece_types() {
+
+  PieceType* list = pieceTypes;
+
+  for (PieceType pt = KNIGHT; pt < KING; ++pt)
+      if (   pt <= QUEEN
+          || pieces(pt)
+          || std::count(gatingPieces + GATE_1, gatingPieces + gateCount + 1, pt))
+          *list++ = pt;
+
+  *list = NO_PIECE_TYPE;
 }
 
 
@@ -444,6 +469,7 @@ void Position::set_check_info(StateInfo* si) const {
   for (PieceType pt = PAWN; pt < KING; ++pt)
       si->checkSquares[pt] = attacks_from(~sideToMove, pt, ksq);
   si->checkSquares[KING]   = 0;
+  si->kingDanger = AllSquares; // Computed on demand
 }
 
 
@@ -462,6 +488,10 @@ void Position::set_state(StateInfo* si) const {
 
   set_check_info(si);
 
+  // The root state is shared by the search threads, so it is not left to
+  // king_danger() to fill it while they search.
+  si->kingDanger = attacks_by(~sideToMove, pieces() ^ square<KING>(sideToMove));
+
   for (Bitboard b = pieces(); b; )
   {
       Square s = pop_lsb(&b);
@@ -596,6 +626,158 @@ const string Position::fen() const {
 }
 
 
+/// Position::set() is an overload to initialize the position object from its
+/// packed binary encoding. As for FENs, the input is assumed to be correct.
+
+Position& Position::set(const PackedPosition& pp, bool isChess960, StateInfo* si, Thread* th) {
+
+  std::memset(this, 0, sizeof(Position));
+  std::memset(si, 0, sizeof(StateInfo));
+  std::fill_n(&pieceList[0][0], sizeof(pieceList) / sizeof(Square), SQ_NONE);
+  st = si;
+
+  // 1. Pieces and gates
+  Bitboard occupied = 0;
+  for (int i = 0; i < 8; ++i)
+      occupied |= Bitboard(pp.occupied[i]) << (8 * i);
+
+  for (int n = 0; occupied && n < 2 * int(sizeof(pp.pieces)); ++n)
+  {
+      PieceType pt = PieceType(((pp.pieces[n / 2] >> (4 * (n & 1))) & 0xF) + 1);
+      Color c = Color((pp.colors[n / 8] >> (n & 7)) & 1);
+      put_piece(make_piece(c, pt), pop_lsb(&occupied));
+  }
+
+  for (int g = 0; g < std::min(pp.gateCounts & 3, MAX_GATES); ++g)
+      set_gating_type(PieceType(((pp.gatingPieces >> (4 * g)) & 0xF) + 1));
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (int g = 0; g < std::min((pp.gateCounts >> (2 + 2 * c)) & 3, MAX_GATES); ++g)
+      {
+          int f = (pp.gateFiles[c] >> (4 * g)) & 0xF;
+          if (f && f <= FILE_NB)
+              put_gating_piece(c, make_square(File(f - 1), relative_rank(c, RANK_1)));
+          else
+              gatingSquares[c][++setupCount[c]] = SQ_NONE;
+      }
+
+  // 2. Active color
+  sideToMove = Color(pp.sideToMove & 1);
+
+  // 3. Castling availability
+  int castling = pp.castling[0] | pp.castling[1] << 8;
+  for (int i = 0; i < 4; ++i)
+      if (castling & (1 << i))
+      {
+          Color c = Color(i / 2);
+          set_castling_right(c, make_square(File((castling >> (4 + 3 * i)) & 7),
+                                            relative_rank(c, RANK_1)));
+      }
+
+  // 4. En passant square
+  int epFile = pp.sideToMove >> 1;
+  st->epSquare = epFile && epFile <= FILE_NB ? make_square(File(epFile - 1), relative_rank(sideToMove, RANK_6))
+                                             : SQ_NONE;
+
+  // 5-6. Halfmove clock and game ply
+  st->rule50 = pp.rule50;
+  gamePly = pp.gamePly[0] | pp.gamePly[1] << 8;
+
+  chess960 = isChess960;
+  thisThread = th;
+  set_piece_types();
+  set_state(st);
+
+  assert(pos_is_ok());
+
+  return *this;
+}
+
+
+/// Position::pack() returns the packed binary encoding of the position
+
+PackedPosition Position::pack() const {
+
+  PackedPosition pp;
+  std::memset(&pp, 0, sizeof(PackedPosition));
+
+  for (int i = 0; i < 8; ++i)
+      pp.occupied[i] = uint8_t(pieces() >> (8 * i));
+
+  int n = 0;
+  for (Bitboard b = pieces(); b; ++n)
+  {
+      Piece pc = piece_on(pop_lsb(&b));
+      pp.pieces[n / 2] |= (type_of(pc) - 1) << (4 * (n & 1));
+      pp.colors[n / 8] |= color_of(pc) << (n & 7);
+  }
+
+  assert(n <= 2 * int(sizeof(pp.pieces)));
+
+  pp.gateCounts = uint8_t(gateCount | setupCount[WHITE] << 2 | setupCount[BLACK] << 4);
+
+  for (Gate g = GATE_1; g <= gateCount; ++g)
+      pp.gatingPieces |= (gatingPieces[g] - 1) << (4 * (g - 1));
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (Gate g = GATE_1; g <= setupCount[c]; ++g)
+          if (gatingSquares[c][g] != SQ_NONE)
+              pp.gateFiles[c] |= (file_of(gatingSquares[c][g]) + 1) << (4 * (g - 1));
+
+  int castling = st->castlingRights;
+  for (int i = 0; i < 4; ++i)
+      if (castling & (1 << i))
+          castling |= file_of(castlingRookSquare[1 << i]) << (4 + 3 * i);
+
+  pp.castling[0] = uint8_t(castling);
+  pp.castling[1] = uint8_t(castling >> 8);
+  pp.sideToMove = uint8_t(sideToMove | (ep_square() != SQ_NONE ? file_of(ep_square()) + 1 : 0) << 1);
+  pp.rule50 = uint8_t(std::min(st->rule50, 255));
+  pp.gamePly[0] = uint8_t(gamePly);
+  pp.gamePly[1] = uint8_t(gamePly >> 8);
+
+  return pp;
+}
+
+
+/// PackedPosition::hex() and PackedPosition::from_hex() convert the packed
+/// encoding to and from a string of hexadecimal digits, as used by the UCI
+/// 'position packed' command.
+
+std::string PackedPosition::hex() const {
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+  std::string str;
+
+  for (size_t i = 0; i < sizeof(PackedPosition); ++i)
+  {
+      str += "0123456789abcdef"[data[i] >> 4];
+      str += "0123456789abcdef"[data[i] & 0xF];
+  }
+
+  return str;
+}
+
+bool PackedPosition::from_hex(const std::string& str) {
+
+  if (str.size() != 2 * sizeof(PackedPosition))
+      return false;
+
+  uint8_t* data = reinterpret_cast<uint8_t*>(this);
+
+  for (size_t i = 0; i < str.size(); ++i)
+  {
+      if (!isxdigit(str[i]))
+          return false;
+
+      int d = isdigit(str[i]) ? str[i] - '0' : tolower(str[i]) - 'a' + 10;
+      data[i / 2] = uint8_t(i & 1 ? data[i / 2] | d : d << 4);
+  }
+
+  return true;
+}
+
+
 /// Position::slider_blockers() returns a bitboard of all the pieces (both colors)
 /// that are blocking attacks on the square 's' from 'sliders'. A piece blocks a
 /// slider if removing that piece from the board would result in a position where
@@ -629,6 +811,25 @@ Bitboard Position::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners
 }
 
 
+/// Position::attacks_by() computes a bitboard of all squares attacked by the
+/// pieces of the given color, with the given occupancy for sliders.
+
+Bitboard Position::attacks_by(Color c, Bitboard occupied) const {
+
+  Bitboard b = c == WHITE ? pawn_attacks_bb<WHITE>(pieces(WHITE, PAWN))
+                          : pawn_attacks_bb<BLACK>(pieces(BLACK, PAWN));
+
+  for (const PieceType* pt = piece_types(); *pt != NO_PIECE_TYPE; ++pt)
+      for (const Square* s = squares(c, *pt); *s != SQ_NONE; ++s)
+          b |= attacks_bb(c, *pt, *s, occupied);
+
+  for (const Square* s = squares<KING>(c); *s != SQ_NONE; ++s)
+      b |= attacks_bb(c, KING, *s, occupied);
+
+  return b;
+}
+
+
 /// Position::attackers_to() computes a bitboard of all pieces which attack a
 /// given square. Slider attacks use the occupied bitboard to indicate occupancy.
 
@@ -636,8 +837,13 @@ Bitboard Position::attackers_to(Square s, Bitboard occupied) const {
 
   Bitboard b = 0;
   for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = PAWN; pt <= KING; ++pt)
-          b |= attacks_bb(~c, pt, s, occupied) & pieces(c, pt);
+  {
+      b |=  (attacks_bb(~c, PAWN, s, occupied) & pieces(c, PAWN))
+          | (attacks_bb(~c, KING, s, occupied) & pieces(c, KING));
+
+      for (const PieceType* pt = piece_types(); *pt != NO_PIECE_TYPE; ++pt)
+          b |= attacks_bb(~c, *pt, s, occupied) & pieces(c, *pt);
+  }
   return b;
 }
 
@@ -683,7 +889,7 @@ bool Position::legal(Move m) const {
   // square is attacked by the opponent. Castling moves are checked
   // for legality during move generation.
   if (type_of(piece_on(from)) == KING)
-      return type_of(m) == CASTLING || !(attackers_to(to_sq(m)) & pieces(~us));
+      return type_of(m) == CASTLING || !(king_danger() & to);
 
   // A non-king move is legal if and only if it is not pinned or it
   // does not expose the king to attackers.
@@ -703,16 +909,35 @@ bool Position::pseudo_legal(const Move m) const {
   Square to = to_sq(m);
   Piece pc = moved_piece(m);
 
-  // Use a slower but simpler function for uncommon cases
-  if (type_of(m) != NORMAL)
-      return MoveList<LEGAL>(*this).contains(m);
-
-  // A normal move during setup phase can not be legal
-  if (game_phase() != GAMEPHASE_PLAYING)
+  // Move type bits not used by any encoding
+  if (type_of(m) > PUT_GATING_PIECE)
       return false;
 
-  // Is not a promotion, so promotion piece must be empty
-  if (promotion_type(m) != NO_PIECE_TYPE)
+  // Gating piece selection: any fairy piece type, encoded on SQ_A1
+  if (type_of(m) == SET_GATING_TYPE)
+      return   game_phase() == GAMEPHASE_SELECTION
+            && to == SQ_A1
+            && gating_type(m) > QUEEN && gating_type(m) < KING;
+
+  // Gating piece placement: the next selected piece onto a free square of our
+  // back rank, where king and rook gates are mutually exclusive.
+  if (type_of(m) == PUT_GATING_PIECE)
+  {
+      if (   game_phase() != GAMEPHASE_PLACING
+          || gating_type(m) != gating_piece(Gate(setup_count(us) + 1))
+          || rank_of(to) != relative_rank(us, RANK_1)
+          || (gates() & to))
+          return false;
+
+      if (pieces(us, KING) & gates())
+          return !(pieces(us, ROOK) & to);
+      if (pieces(us, ROOK) & gates())
+          return !(pieces(us, KING) & to);
+      return true;
+  }
+
+  // Any other move during setup phase can not be legal
+  if (game_phase() != GAMEPHASE_PLAYING)
       return false;
 
   // If the 'from' square is not occupied by a piece belonging to the side to
@@ -720,12 +945,80 @@ bool Position::pseudo_legal(const Move m) const {
   if (pc == NO_PIECE || color_of(pc) != us)
       return false;
 
+  // Castling is encoded as 'king captures rook'. As for the generator we also
+  // check here that the king does not pass through attacked squares, since
+  // legal() relies on this.
+  if (type_of(m) == CASTLING)
+  {
+      bool kingSide = to > from;
+      CastlingRight cr = us | (kingSide ? KING_SIDE : QUEEN_SIDE);
+
+      if (   checkers()
+          || type_of(pc) != KING
+          || !can_castle(cr)
+          || castling_impeded(cr)
+          || castling_rook_square(cr) != to)
+          return false;
+
+      Square kto = relative_square(us, kingSide ? SQ_G1 : SQ_C1);
+      Direction step = kto > from ? WEST : EAST;
+
+      for (Square s = kto; s != from; s += step)
+          if (king_danger() & s)
+              return false;
+
+      return !chess960 || !(attackers_to(kto, pieces() ^ to) & pieces(~us));
+  }
+
   // The destination square cannot be occupied by a friendly piece
   if (pieces(us) & to)
       return false;
 
+  if (type_of(m) == ENPASSANT)
+  {
+      if (   to != ep_square()
+          || type_of(pc) != PAWN
+          || !(attacks_from<PAWN>(us, from) & to))
+          return false;
+
+      // As in the evasions generator, an en passant capture resolves a check
+      // only if the captured pawn is the checking piece.
+      if (checkers())
+      {
+          Square checksq = lsb(checkers());
+          Bitboard target = between_bb(checksq, square<KING>(us)) | checksq;
+          if (LeaperAttacks[~us][type_of(piece_on(checksq))][checksq] & square<KING>(us))
+              target = SquareBB[checksq];
+
+          return !more_than_one(checkers()) && (target & (to - pawn_push(us)));
+      }
+      return true;
+  }
+
+  if (type_of(m) == PROMOTION)
+  {
+      if (rank_of(to) != relative_rank(us, RANK_8) || type_of(pc) != PAWN)
+          return false;
+
+      // Promotion piece must be one of the standard pieces or a gating piece
+      PieceType promotion = promotion_type(m);
+      if (promotion < KNIGHT || promotion > QUEEN)
+      {
+          Gate g = GATE_1;
+          while (g < GATE_NB && gating_piece(g) != promotion)
+              ++g;
+          if (g == GATE_NB)
+              return false;
+      }
+
+      // The direction is part of the encoding, so from_sq() already gives
+      // a square in front of, left or right of the destination.
+      if (from + pawn_push(us) == to ? !empty(to) : !(attacks_from<PAWN>(us, from) & pieces(~us) & to))
+          return false;
+  }
+
   // Handle the special case of a pawn move
-  if (type_of(pc) == PAWN)
+  else if (type_of(pc) == PAWN)
   {
       // We have already handled promotion moves, so destination
       // cannot be on the 8th/1st rank.
@@ -754,15 +1047,17 @@ bool Position::pseudo_legal(const Move m) const {
           if (more_than_one(checkers()))
               return false;
 
-          // Our move must be a blocking evasion or a capture of the checking piece
+          // Our move must be a blocking evasion or a capture of the checking
+          // piece. Leaper attacks can not be blocked.
           Square checksq = lsb(checkers());
           if (  !((between_bb(checksq, square<KING>(us)) | checkers()) & to)
-              || (LeaperAttacks[~us][type_of(piece_on(checksq))][checksq] & square<KING>(us)))
+              || (   (LeaperAttacks[~us][type_of(piece_on(checksq))][checksq] & square<KING>(us))
+                  && to != checksq))
               return false;
       }
       // In case of king moves under check we have to remove king so as to catch
       // invalid moves like b1a1 when opposite queen is on c1.
-      else if (attackers_to(to, pieces() ^ from) & pieces(~us))
+      else if (king_danger() & to)
           return false;
   }
 
@@ -864,6 +1159,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   switch (type_of(m))
   {
   case SET_GATING_TYPE:
+      st->capturedPiece = NO_PIECE;
       if (gateCount == NO_GATE || gating_type(m) != gatingPieces[gateCount])
       {
           set_gating_type(gating_type(m));
@@ -882,6 +1178,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       break;
   case PUT_GATING_PIECE:
       assert(gating_type(m) == gatingPieces[setupCount[us] + 1]);
+      st->capturedPiece = NO_PIECE;
       put_gating_piece(us, to_sq(m));
       st->psq += PSQT::psq_gate[make_piece(us, gating_type(m))][file_of(to_sq(m))];
       k ^= Zobrist::psq_gate[make_piece(us, gating_type(m))][file_of(to_sq(m))];
@@ -908,9 +1205,10 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           assert(captured == make_piece(us, ROOK));
 
           Square rfrom, rto;
+          CastlingRight cr = us | (to > from ? KING_SIDE : QUEEN_SIDE);
           do_castling<true>(us, from, to, rfrom, rto, k);
 
-          st->psq += PSQT::psq[captured][rto] - PSQT::psq[captured][rfrom];
+          st->psq += castlingPsq[cr]; // King and rook together
           k ^= Zobrist::psq[captured][rfrom] ^ Zobrist::psq[captured][rto];
           captured = NO_PIECE;
       }
@@ -986,10 +1284,11 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       if (type_of(m) != CASTLING)
       {
           move_piece(pc, from, to);
+          st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
           if (gateBB & from)
           {
               Piece gated_piece = make_piece(us, gating_piece(from));
-              st->psq += PSQT::psq[gated_piece][from] - PSQT::psq_gate[gated_piece][file_of(from)];
+              st->psq += PSQT::psq_gated[gated_piece][file_of(from)];
               k ^= Zobrist::psq[gated_piece][from] ^ Zobrist::psq_gate[gated_piece][file_of(from)];
               gate_piece(us, from);
           }
@@ -1037,9 +1336,6 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           st->rule50 = 0;
       }
 
-      // Update incremental scores
-      st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
-
       // Set capture piece
       st->capturedPiece = captured;
   }
@@ -1049,6 +1345,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
   // Update the key with the final value
   st->key = k;
+  ++thisThread->keyFilter[k & (Thread::KeyFilterSize - 1)];
 
   sideToMove = ~sideToMove;
 
@@ -1066,6 +1363,8 @@ void Position::undo_move(Move m) {
 
   assert(is_ok(m));
 
+  --thisThread->keyFilter[st->key & (Thread::KeyFilterSize - 1)];
+
   sideToMove = ~sideToMove;
 
   Color us = sideToMove;
@@ -1179,7 +1478,7 @@ void Position::do_castling(Color us, Square from, Square& to, Square& rfrom, Squ
     if (s != to && s != rto)
     {
         Piece gated_piece = make_piece(us, gating_piece(s));
-        st->psq += PSQT::psq[gated_piece][s] - PSQT::psq_gate[gated_piece][file_of(s)];
+        st->psq += PSQT::psq_gated[gated_piece][file_of(s)];
         k ^= Zobrist::psq[gated_piece][s] ^ Zobrist::psq_gate[gated_piece][file_of(s)];
         gate_piece(us, s);
     }
@@ -1215,6 +1514,7 @@ void Position::do_null_move(StateInfo& newSt) {
   }
 
   st->key ^= Zobrist::side;
+  ++thisThread->keyFilter[st->key & (Thread::KeyFilterSize - 1)];
   prefetch(TT.first_entry(st->key));
 
   ++st->rule50;
@@ -1231,6 +1531,7 @@ void Position::undo_null_move() {
 
   assert(!checkers());
 
+  --thisThread->keyFilter[st->key & (Thread::KeyFilterSize - 1)];
   st = st->previous;
   sideToMove = ~sideToMove;
 }
@@ -1353,7 +1654,9 @@ bool Position::is_draw(int ply) const {
 
   int end = std::min(st->rule50, st->pliesFromNull);
 
-  if (end < 4)
+  // The repetition filter counts the current position too. When it is alone
+  // with its key bits, no earlier position can repeat it.
+  if (end < 4 || thisThread->keyFilter[st->key & (Thread::KeyFilterSize - 1)] < 2)
     return false;
 
   StateInfo* stp = st->previous->previous;
@@ -1403,6 +1706,26 @@ bool Position::has_repeated() const {
 }
 
 
+/// Position::init_key_filter() resets the repetition filter of the thread and
+/// adds the keys of the position and of the game history within reach of a
+/// repetition. It is called for the root position of every search, once the
+/// list of the states of the game is attached.
+
+void Position::init_key_filter() {
+
+  StateInfo* stp = st;
+
+  std::memset(thisThread->keyFilter, 0, sizeof(thisThread->keyFilter));
+  ++thisThread->keyFilter[st->key & (Thread::KeyFilterSize - 1)];
+
+  for (int i = std::min(st->rule50, st->pliesFromNull); i > 0 && stp->previous; --i)
+  {
+      stp = stp->previous;
+      ++thisThread->keyFilter[stp->key & (Thread::KeyFilterSize - 1)];
+  }
+}
+
+
 /// Position::has_game_cycle() tests if the position has a move which draws by repetition,
 /// or an earlier position has a move that directly reaches the current position.
 
@@ -1531,6 +1854,8 @@ bool Position::pos_is_ok() const {
 
   StateInfo si = *st;
   set_state(&si);
+  if (st->kingDanger == AllSquares)
+      si.kingDanger = AllSquares; // Not computed yet at this node
   if (std::memcmp(&si, st, sizeof(StateInfo)))
       assert(0 && "pos_is_ok: State");
 
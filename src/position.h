@@ -57,6 +57,7 @@ struct StateInfo {
   Bitboard   blockersForKing[COLOR_NB];
   Bitboard   pinners[COLOR_NB];
   Bitboard   checkSquares[PIECE_TYPE_NB];
+  Bitboard   kingDanger;
 };
 
 /// A list to keep track of the position states along the setup moves (from the
@@ -66,6 +67,32 @@ struct StateInfo {
 typedef std::unique_ptr<std::deque<StateInfo>> StateListPtr;
 
 
+/// PackedPosition is a fixed size binary encoding of a position, much faster
+/// to produce and to parse than a FEN string. The pieces are listed in the
+/// square order of the occupied bitboard, with their type in a nibble and
+/// their color in a bit. Gates are stored as the file + 1 of the gating square
+/// of each color and gate, 0 for a gate that is already used.
+
+struct PackedPosition {
+
+  std::string hex() const;
+  bool from_hex(const std::string& str);
+
+  uint8_t occupied[8];  // Occupied squares bitboard, little endian
+  uint8_t pieces[18];   // Piece types - 1
+  uint8_t colors[5];    // Piece colors
+  uint8_t gateCounts;   // Selected gating pieces, placed gates of each color (2 bits each)
+  uint8_t gatingPieces; // Gating piece types - 1
+  uint8_t gateFiles[COLOR_NB];
+  uint8_t castling[2];  // Castling rights and rook files (3 bits each)
+  uint8_t sideToMove;   // Side to move and en passant file + 1 (0 if none)
+  uint8_t rule50;
+  uint8_t gamePly[2];
+};
+
+static_assert(sizeof(PackedPosition) == 41 && MAX_GATES == 2, "PackedPosition layout incorrect");
+
+
 /// Position class stores information regarding the board representation as
 /// pieces, side to move, hash keys, castling info, etc. Important methods are
 /// do_move() and undo_move(), used by the search to update node info when
@@ -80,10 +107,12 @@ public:
   Position(const Position&) = delete;
   Position& operator=(const Position&) = delete;
 
-  // FEN string input/output
+  // FEN string and packed input/output
   Position& set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th);
   Position& set(const std::string& code, Color c, StateInfo* si);
+  Position& set(const PackedPosition& pp, bool isChess960, StateInfo* si, Thread* th);
   const std::string fen() const;
+  PackedPosition pack() const;
 
   // Position representation
   Bitboard pieces() const;
@@ -99,6 +128,7 @@ public:
   template<PieceType Pt> int count() const;
   template<PieceType Pt> const Square* squares(Color c) const;
   const Square* squares(Color c, PieceType pt) const;
+  const PieceType* piece_types() const;
   template<PieceType Pt> Square square(Color c) const;
   Bitboard gates() const;
   PieceType gating_piece(Gate gate) const;
@@ -115,6 +145,7 @@ public:
   Bitboard checkers() const;
   Bitboard blockers_for_king(Color c) const;
   Bitboard check_squares(PieceType pt) const;
+  Bitboard king_danger() const;
 
   // Attacks to/from a given square
   Bitboard attackers_to(Square s) const;
@@ -122,6 +153,7 @@ public:
   Bitboard attacks_from(Color c, PieceType pt, Square s) const;
   template<PieceType> Bitboard attacks_from(Color c, Square s) const;
   Bitboard slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const;
+  Bitboard attacks_by(Color c, Bitboard occupied) const;
 
   // Properties of moves
   bool legal(Move m) const;
@@ -161,6 +193,7 @@ public:
   bool is_draw(int ply) const;
   bool has_game_cycle(int ply) const;
   bool has_repeated() const;
+  void init_key_filter();
   int rule50_count() const;
   Score psq_score() const;
   Value non_pawn_material(Color c) const;
@@ -182,6 +215,7 @@ private:
   // Other helpers
   void set_gating_type(PieceType pt);
   void unset_gating_type();
+  void set_piece_types();
   void add_gate(Color c, Square s, Gate gate);
   void remove_gate(Color c, Square s, Gate gate);
   void put_gating_piece(Color c, Square s);
@@ -200,6 +234,7 @@ private:
   Piece board[SQUARE_NB];
   Gate gateBoard[SQUARE_NB];
   PieceType gatingPieces[GATE_NB];
+  PieceType pieceTypes[KING];
   Square gatingSquares[COLOR_NB][GATE_NB];
   Bitboard byTypeBB[PIECE_TYPE_NB];
   Bitboard byColorBB[COLOR_NB];
@@ -212,6 +247,7 @@ private:
   int castlingRightsMask[SQUARE_NB];
   Square castlingRookSquare[CASTLING_RIGHT_NB];
   Bitboard castlingPath[CASTLING_RIGHT_NB];
+  Score castlingPsq[CASTLING_RIGHT_NB];
   int gamePly;
   Color sideToMove;
   Thread* thisThread;
@@ -288,6 +324,10 @@ inline Bitboard Position::gates() const {
   return gateBB;
 }
 
+inline const PieceType* Position::piece_types() const {
+  return pieceTypes;
+}
+
 inline PieceType Position::gating_piece(Gate gate) const {
   assert(gate >= NO_GATE && gate < GATE_NB);
   return gatingPieces[gate];
@@ -341,6 +381,16 @@ inline Bitboard Position::checkers() const {
   return st->checkersBB;
 }
 
+/// Position::king_danger() returns the squares attacked by the opponent, seen
+/// through our king. It is computed on first use at each node, except at the
+/// root where set() computes it.
+
+inline Bitboard Position::king_danger() const {
+  if (st->kingDanger == AllSquares)
+      st->kingDanger = attacks_by(~sideToMove, pieces() ^ square<KING>(sideToMove));
+  return st->kingDanger;
+}
+
 inline Bitboard Position::blockers_for_king(Color c) const {
   return st->blockersForKing[c];
 }
@@ -436,11 +486,13 @@ inline Thread* Position::this_thread() const {
 inline void Position::set_gating_type(PieceType pt) {
   assert(gateCount < GATE_NB);
   gatingPieces[++gateCount] = pt;
+  set_piece_types();
 }
 
 inline void Position::unset_gating_type() {
   assert(gateCount > NO_GATE);
   gatingPieces[gateCount--] = NO_PIECE_TYPE;
+  set_piece_types();
 }
 
 inline void Position::add_gate(Color c, Square s, Gate gate) {
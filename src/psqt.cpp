@@ -200,8 +200,12 @@ constexpr Score Bonus[PIECE_TYPE_NB][RANK_NB][int(FILE_NB) / 2] = {
 
 #undef S
 
-Score psq[PIECE_NB][SQUARE_NB];
+// Rows are cache line aligned, so that a piece's scores span exactly 4 lines.
+// psq_gated[] holds the combined change when a gating piece enters the board
+// on its gate, i.e. psq[] of the back rank square minus psq_gate[].
+alignas(64) Score psq[PIECE_NB][SQUARE_NB];
 Score psq_gate[PIECE_NB][FILE_NB];
+Score psq_gated[PIECE_NB][FILE_NB];
 
 // init() initializes piece-square tables: the white halves of the tables are
 // copied from Bonus[] adding the piece value, then the black halves of the
@@ -228,6 +232,11 @@ void init() {
           psq_gate[ pc][ f] = score;
           psq_gate[~pc][~f] = -psq_gate[pc][f];
       }
+      for (File f = FILE_A; f <= FILE_H; ++f)
+      {
+          psq_gated[ pc][f] = psq[ pc][make_square(f, RANK_1)] - psq_gate[ pc][f];
+          psq_gated[~pc][f] = psq[~pc][make_square(f, RANK_8)] - psq_gate[~pc][f];
+      }
   }
 }
 
@@ -96,6 +96,35 @@ namespace {
     Move best = MOVE_NONE;
   };
 
+  // Search budgets of the handicap levels: a depth limit (0 for none), a node
+  // budget and the largest random bonus of a root move, in centipawns.
+  struct HandicapBudget { int depth, nodes, noise; };
+
+  HandicapBudget HandicapLevels[] = {
+    { 1, 100000, 40 }, { 1, 100000, 10 }, { 2, 100000, 60 }, { 2, 100000, 25 },
+    { 0,  240, 45 }, { 0,  370, 40 }, { 0,  550, 35 }, { 0,  730, 30 },
+    { 0,  970, 25 }, { 0, 1220, 20 }, { 0, 1520, 15 }, { 0, 1920, 15 },
+    { 0, 2340, 15 }, { 0, 2800, 15 }, { 0, 3360, 15 }, { 0, 4020, 15 },
+    { 0, 4770, 15 }, { 0, 5690, 15 }, { 0, 6750, 15 }, { 0, 8060, 15 }
+  };
+
+  // Handicap structure implements a cheap strength limit, for hosting many
+  // games at once: the search budgets of the level and a random bonus for each
+  // root move.
+  struct Handicap {
+    explicit Handicap(int l) : level(l) {}
+    bool enabled() const { return level < 20; }
+    int depth() const { return HandicapLevels[level].depth; }
+    Value noise(PRNG& rng) const {
+      return Value(rng.rand<unsigned>() % (1 + HandicapLevels[level].noise * PawnValueEg / 100));
+    }
+    int64_t nodes() const {
+      return std::min(int64_t(Options["Handicap Nodes"]), int64_t(HandicapLevels[level].nodes));
+    }
+
+    int level;
+  };
+
   template <NodeType NT>
   Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode);
 
@@ -122,6 +151,32 @@ namespace {
     uint64_t cnt, nodes = 0;
     const bool leaf = (depth == 2 * ONE_PLY);
 
+#ifndef NDEBUG
+    // Randomized self-test of pseudo_legal(): the generated legal moves with
+    // all possible move types and a batch of random encodings must be accepted
+    // by pseudo_legal() and legal() exactly when the generator produces them.
+    static PRNG rng(1070372);
+    MoveList<LEGAL> legalMoves(pos);
+    auto check = [&](Move m) {
+        assert(  (is_ok(m) && pos.pseudo_legal(m) && pos.legal(m))
+               == legalMoves.contains(m));
+    };
+    for (const auto& m : legalMoves)
+        for (int t = 0; t < 8; ++t)
+            check(Move((m & ~(15 << 12)) | (t << 12)));
+    for (int i = 0; i < 32; ++i)
+        check(Move(rng.rand<uint16_t>() & 0x7FFF));
+
+    // Round trip of the packed encoding: the decoded position must have the
+    // same FEN and key, and pack back to the same bytes.
+    StateInfo pst;
+    Position unpacked;
+    unpacked.set(pos.pack(), pos.is_chess960(), &pst, pos.this_thread());
+    assert(   unpacked.fen() == pos.fen()
+           && unpacked.key() == pos.key()
+           && unpacked.pack().hex() == pos.pack().hex());
+#endif
+
     for (const auto& m : MoveList<LEGAL>(pos))
     {
         if (Root && depth <= ONE_PLY)
@@ -173,9 +228,19 @@ void Search::init() {
 void Search::clear() {
 
   Threads.main()->wait_for_search_finished();
+  Bitbases::wait();
 
   Time.availableNodes = 0;
-  TT.clear();
+
+  // A hash size chosen by a timed search is applied here, between games. The
+  // resize clears the table.
+  if (   Options["Auto Hash"]
+      && Threads.nextHashMB
+      && Threads.nextHashMB != size_t(Options["Hash"]))
+      Options["Hash"] = std::to_string(Threads.nextHashMB);
+  else
+      TT.clear();
+
   Threads.clear();
 }
 
@@ -192,6 +257,25 @@ void MainThread::search() {
       return;
   }
 
+  // When playing with a handicap, cap the search at the node and depth budgets
+  // of the level and draw the root move bonuses, the same for all threads.
+  Handicap handicap(Options["Handicap Level"]);
+  if (handicap.enabled())
+  {
+      static PRNG rng(now()); // PRNG sequence should be non-deterministic
+
+      if (handicap.depth())
+          Limits.depth = Limits.depth ? std::min(Limits.depth, handicap.depth()) : handicap.depth();
+      Limits.nodes = Limits.nodes ? std::min(Limits.nodes, handicap.nodes()) : handicap.nodes();
+
+      for (RootMove& rm : rootMoves)
+          rm.noise = handicap.noise(rng);
+
+      for (Thread* th : Threads)
+          for (size_t i = 0; th != this && i < rootMoves.size(); ++i)
+              th->rootMoves[i].noise = rootMoves[i].noise;
+  }
+
   Color us = rootPos.side_to_move();
   Time.init(Limits, us, rootPos.game_ply());
   TT.new_search();
@@ -242,6 +326,10 @@ void MainThread::search() {
   if (Limits.npmsec)
       Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
 
+  // Measure the speed of timed searches, used to size the hash automatically
+  else if (Limits.use_time_management() && Time.elapsed() >= 100)
+      Threads.nps = Threads.nodes_searched() * 1000 / Time.elapsed();
+
   // Check if there are threads with a better score than main thread
   bestThread = this;
   if (    Options["MultiPV"] == 1
@@ -263,6 +351,15 @@ void MainThread::search() {
 
   previousScore = bestThread->rootMoves[0].score;
 
+  // Remember the line we expect, to continue from it on the next search
+  previousPv = bestThread->rootMoves[0].pv;
+  previousDepth = bestThread->completedDepth;
+  previousRootKey = rootPos.key();
+
+  // A silent search is run by a command that reports the result itself
+  if (Limits.silent)
+      return;
+
   // Send again PV info if we have a new best thread
   if (bestThread != this)
       sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
@@ -299,6 +396,7 @@ void Thread::search() {
   bool failedLow;
 
   std::memset(ss-4, 0, 7 * sizeof(Stack));
+  qsearchTT.new_search();
   for (int i = 4; i > 0; i--)
      (ss-i)->contHistory = this->contHistory[NO_PIECE][0].get(); // Use as sentinel
 
@@ -376,8 +474,8 @@ void Thread::search() {
           {
               Value previousScore = rootMoves[pvIdx].previousScore;
               delta = Value(18);
-              alpha = std::max(previousScore - delta,-VALUE_INFINITE);
-              beta  = std::min(previousScore + delta, VALUE_INFINITE);
+              alpha = std::max(rootMoves[pvIdx].noisy(previousScore) - delta,-VALUE_INFINITE);
+              beta  = std::min(rootMoves[pvIdx].noisy(previousScore) + delta, VALUE_INFINITE);
 
               // Adjust contempt based on root move's previousScore (dynamic contempt)
               int dct = ct + 88 * previousScore / (abs(previousScore) + 200);
@@ -410,6 +508,7 @@ void Thread::search() {
               // When failing high/low give some update (without cluttering
               // the UI) before a re-search.
               if (   mainThread
+                  && !Limits.silent
                   && multiPV == 1
                   && (bestValue <= alpha || bestValue >= beta)
                   && Time.elapsed() > 3000)
@@ -442,6 +541,7 @@ void Thread::search() {
           std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
           if (    mainThread
+              && !Limits.silent
               && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > 3000))
               sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
       }
@@ -853,7 +953,8 @@ moves_loop: // When in check, search starts from here
                                       &thisThread->captureHistory,
                                       contHist,
                                       countermove,
-                                      ss->killers);
+                                      ss->killers,
+                                      thisThread->moveListCache);
     value = bestValue; // Workaround a bogus 'uninitialized' warning under gcc
 
     skipQuiets = false;
@@ -879,7 +980,8 @@ moves_loop: // When in check, search starts from here
 
       ss->moveCount = ++moveCount;
 
-      if (rootNode && thisThread == Threads.main() && Time.elapsed() > 3000 && Options["Protocol"] == "uci")
+      if (   rootNode && thisThread == Threads.main() && Time.elapsed() > 3000
+          && Options["Protocol"] == "uci" && !Limits.silent)
           sync_cout << "info depth " << depth / ONE_PLY
                     << " currmove " << UCI::move(move, pos)
                     << " currmovenumber " << moveCount + thisThread->pvIdx << sync_endl;
@@ -983,6 +1085,18 @@ moves_loop: // When in check, search starts from here
       ss->currentMove = move;
       ss->contHistory = thisThread->contHistory[movedPiece][to_sq(move)].get();
 
+      // With a strength handicap each root move gets a random bonus. We search
+      // it with the window shifted by this bonus, and add it to the result to
+      // pick the best move. The root move score is stored without it.
+      Value noise = VALUE_ZERO, rootAlpha = alpha, rootBeta = beta;
+      if (rootNode && (noise = std::find(thisThread->rootMoves.begin(),
+                                         thisThread->rootMoves.end(), move)->noise))
+      {
+          alpha = std::max(alpha - noise, -VALUE_INFINITE);
+          if (beta != VALUE_INFINITE)
+              beta = std::max(beta - noise, alpha + 1);
+      }
+
       // Step 15. Make the move
       pos.do_move(move, st, givesCheck);
 
@@ -1071,6 +1185,16 @@ moves_loop: // When in check, search starts from here
       // Step 18. Undo move
       pos.undo_move(move);
 
+      if (noise)
+      {
+          alpha = rootAlpha;
+          beta = rootBeta;
+          if (abs(value) < VALUE_KNOWN_WIN)
+              value += noise;
+          else
+              noise = VALUE_ZERO;
+      }
+
       assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
       // Step 19. Check for a new best move
@@ -1088,7 +1212,7 @@ moves_loop: // When in check, search starts from here
           // PV move or new best move?
           if (moveCount == 1 || value > alpha)
           {
-              rm.score = value;
+              rm.score = value - noise;
               rm.selDepth = thisThread->selDepth;
               rm.pv.resize(1);
 
@@ -1182,7 +1306,11 @@ moves_loop: // When in check, search starts from here
     if (PvNode)
         bestValue = std::min(bestValue, maxValue);
 
-    if (!excludedMove)
+    // With a strength handicap the root value includes the random bonus of the
+    // root moves, so it is kept out of the TT.
+    if (   !excludedMove
+        && !(rootNode && std::any_of(thisThread->rootMoves.begin(), thisThread->rootMoves.end(),
+                                     [](const RootMove& rm) { return rm.noise != VALUE_ZERO; })))
         tte->save(posKey, value_to_tt(bestValue, ss->ply),
                   bestValue >= beta ? BOUND_LOWER :
                   PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
@@ -1240,9 +1368,20 @@ moves_loop: // When in check, search starts from here
     // only two types of depth in TT: DEPTH_QS_CHECKS or DEPTH_QS_NO_CHECKS.
     ttDepth = inCheck || depth >= DEPTH_QS_CHECKS ? DEPTH_QS_CHECKS
                                                   : DEPTH_QS_NO_CHECKS;
-    // Transposition table lookup
+    // Transposition table lookup. With a per-thread qsearch table we probe and
+    // store there, falling back on the shared table only for reading.
+    TranspositionTable& tt = pos.this_thread()->qsearchTT.enabled()
+                           ? pos.this_thread()->qsearchTT : TT;
     posKey = pos.key();
-    tte = TT.probe(posKey, ttHit);
+    tte = tt.probe(posKey, ttHit);
+
+    if (!ttHit && &tt != &TT)
+    {
+        TTEntry* mainTte = TT.probe(posKey, ttHit);
+        if (ttHit)
+            *tte = *mainTte;
+    }
+
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
     ttMove = ttHit ? tte->move() : MOVE_NONE;
 
@@ -1283,7 +1422,7 @@ moves_loop: // When in check, search starts from here
         {
             if (!ttHit)
                 tte->save(posKey, value_to_tt(bestValue, ss->ply), BOUND_LOWER,
-                          DEPTH_NONE, MOVE_NONE, ss->staticEval, TT.generation());
+                          DEPTH_NONE, MOVE_NONE, ss->staticEval, tt.generation());
 
             return bestValue;
         }
@@ -1346,7 +1485,7 @@ moves_loop: // When in check, search starts from here
           continue;
 
       // Speculative prefetch as early as possible
-      prefetch(TT.first_entry(pos.key_after(move)));
+      prefetch(tt.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
       if (!pos.legal(move))
@@ -1382,7 +1521,7 @@ moves_loop: // When in check, search starts from here
               else // Fail high
               {
                   tte->save(posKey, value_to_tt(value, ss->ply), BOUND_LOWER,
-                            ttDepth, move, ss->staticEval, TT.generation());
+                            ttDepth, move, ss->staticEval, tt.generation());
 
                   return value;
               }
@@ -1397,7 +1536,7 @@ moves_loop: // When in check, search starts from here
 
     tte->save(posKey, value_to_tt(bestValue, ss->ply),
               PvNode && bestValue > oldAlpha ? BOUND_EXACT : BOUND_UPPER,
-              ttDepth, bestMove, ss->staticEval, TT.generation());
+              ttDepth, bestMove, ss->staticEval, tt.generation());
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1536,6 +1675,45 @@ moves_loop: // When in check, search starts from here
 
 } // namespace
 
+/// MainThread::continuation() is called before a new search, while rootPos
+/// still holds the previous root. If the new root is the position expected
+/// after the first two moves of the previous PV, the third one is put first
+/// with its PV and score, so that the aspiration window is centered from the
+/// first iteration, and the depth to restart the iterative deepening from is
+/// returned.
+
+Depth MainThread::continuation(const Position& pos, Search::RootMoves& rms) {
+
+  if (   previousPv.size() < 3
+      || rootPos.key() != previousRootKey
+      || !Limits.use_time_management()
+      || Options["MultiPV"] != 1
+      || Skill(Options["Skill Level"]).enabled()
+      || Handicap(Options["Handicap Level"]).enabled()
+      || TB::RootInTB
+      || abs(previousScore) >= VALUE_KNOWN_WIN)
+      return DEPTH_ZERO;
+
+  StateInfo st[2];
+  rootPos.do_move(previousPv[0], st[0]);
+  rootPos.do_move(previousPv[1], st[1]);
+  bool expected = rootPos.key() == pos.key();
+  rootPos.undo_move(previousPv[1]);
+  rootPos.undo_move(previousPv[0]);
+
+  auto rm = std::find(rms.begin(), rms.end(), previousPv[2]);
+
+  if (!expected || rm == rms.end())
+      return DEPTH_ZERO;
+
+  std::rotate(rms.begin(), rm, rm + 1);
+  rms[0].pv.assign(previousPv.begin() + 2, previousPv.end());
+  rms[0].score = rms[0].previousScore = previousScore;
+
+  return std::max(previousDepth - 4 * ONE_PLY, DEPTH_ZERO);
+}
+
+
 /// MainThread::check_time() is used to print debug info and, more importantly,
 /// to detect when we are out of available time and thus stop the search.
 
@@ -1620,7 +1798,8 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
          << " score "    << UCI::value(v);
 
       if (!tb && i == pvIdx)
-          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
+          ss << (  rootMoves[i].noisy(v) >= beta  ? " lowerbound"
+                 : rootMoves[i].noisy(v) <= alpha ? " upperbound" : "");
 
       ss << " nodes "    << nodesSearched
          << " nps "      << nodesSearched * 1000 / elapsed;
@@ -1688,6 +1867,8 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
 
     if (Cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
     {
+        TimePoint elapsed = now();
+
         // Rank moves using DTZ tables
         RootInTB = root_probe(pos, rootMoves);
 
@@ -1697,6 +1878,11 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
             dtz_available = false;
             RootInTB = root_probe_wdl(pos, rootMoves);
         }
+
+        if (RootInTB && !Limits.silent)
+            sync_cout << "info string Ranked " << rootMoves.size() << " root moves with "
+                      << (dtz_available ? "DTZ" : "WDL") << " tables in "
+                      << now() - elapsed << " ms" << sync_endl;
     }
 
     if (RootInTB)
@@ -62,12 +62,14 @@ struct RootMove {
   bool extract_ponder_from_tt(Position& pos);
   bool operator==(const Move& m) const { return pv[0] == m; }
   bool operator<(const RootMove& m) const { // Sort in descending order
-    return m.score != score ? m.score < score
-                            : m.previousScore < previousScore;
+    return m.noisy(m.score) != noisy(score) ? m.noisy(m.score) < noisy(score)
+                                            : m.previousScore < previousScore;
   }
+  Value noisy(Value v) const { return abs(v) < VALUE_KNOWN_WIN ? v + noise : v; }
 
   Value score = -VALUE_INFINITE;
   Value previousScore = -VALUE_INFINITE;
+  Value noise = VALUE_ZERO;
   int selDepth = 0;
   int tbRank;
   Value tbScore;
@@ -84,7 +86,7 @@ struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
     time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
-    movestogo = depth = mate = perft = infinite = 0;
+    movestogo = depth = mate = perft = infinite = silent = 0;
     nodes = 0;
   }
 
@@ -94,7 +96,7 @@ struct LimitsType {
 
   std::vector<Move> searchmoves;
   TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
-  int movestogo, depth, mate, perft, infinite;
+  int movestogo, depth, mate, perft, infinite, silent;
   int64_t nodes;
 };
 
@@ -19,19 +19,26 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <climits>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>   // For std::memset and std::memcpy
 #include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include "../bitboard.h"
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../thread_win32.h"
 #include "../types.h"
 #include "../uci.h"
@@ -39,6 +46,7 @@
 #include "tbprobe.h"
 
 #ifndef _WIN32
+#include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -67,8 +75,6 @@ inline WDLScore operator-(WDLScore d) { return WDLScore(-int(d)); }
 inline Square operator^=(Square& s, int i) { return s = Square(int(s) ^ i); }
 inline Square operator^(Square s, int i) { return Square(int(s) ^ i); }
 
-const std::string PieceToChar = " PNBRQK  pnbrqk";
-
 int MapPawns[SQUARE_NB];
 int MapB1H1H7[SQUARE_NB];
 int MapA1D1D4[SQUARE_NB];
@@ -167,7 +173,7 @@ static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 
 // class TBFile memory maps/unmaps the single .rtbw and .rtbz files. Files are
 // memory mapped for best performance. Files are mapped at first access: at init
-// time only existence of the file is checked.
+// time only the directory listings are read.
 class TBFile : public std::ifstream {
 
     std::string fname;
@@ -181,24 +187,22 @@ public:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
     static std::string Paths;
 
+    // Full path of every table file found in Paths, filled by scan(). When a
+    // file is present in more than one directory the first one wins.
+    static std::map<std::string, std::string> Files;
+
     TBFile(const std::string& f) {
 
-#ifndef _WIN32
-        constexpr char SepChar = ':';
-#else
-        constexpr char SepChar = ';';
-#endif
-        std::stringstream ss(Paths);
-        std::string path;
+        auto it = Files.find(f);
 
-        while (std::getline(ss, path, SepChar)) {
-            fname = path + "/" + f;
+        if (it != Files.end()) {
+            fname = it->second;
             std::ifstream::open(fname);
-            if (is_open())
-                return;
         }
     }
 
+    static void scan(const std::string& indexFile);
+
     // Memory map the file and check it. File should be already open and will be
     // closed after mapping.
     uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
@@ -275,6 +279,165 @@ public:
 };
 
 std::string TBFile::Paths;
+std::map<std::string, std::string> TBFile::Files;
+
+
+// dir_mtime() returns the last modification time of a directory, which changes
+// whenever a file is added to or removed from it, or 0 if it does not exist.
+// The time is in nanoseconds, so that a table copied in the same second as the
+// index was written still changes it.
+uint64_t dir_mtime(const std::string& dir) {
+
+#ifndef _WIN32
+    struct stat statbuf;
+
+    if (stat(dir.c_str(), &statbuf) || !S_ISDIR(statbuf.st_mode))
+        return 0;
+
+#ifdef __APPLE__
+    return uint64_t(statbuf.st_mtimespec.tv_sec) * 1000000000 + statbuf.st_mtimespec.tv_nsec;
+#else
+    return uint64_t(statbuf.st_mtim.tv_sec) * 1000000000 + statbuf.st_mtim.tv_nsec;
+#endif
+#else
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (   !GetFileAttributesEx(dir.c_str(), GetFileExInfoStandard, &data)
+        || !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return 0;
+
+    return (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32)
+          | data.ftLastWriteTime.dwLowDateTime;
+#endif
+}
+
+
+// list_tables() reads the directory once and returns the names of the .rtbw
+// and .rtbz files in it.
+std::vector<std::string> list_tables(const std::string& dir) {
+
+    std::vector<std::string> names;
+    auto isTable = [](const std::string& name) {
+        return    name.size() > 5
+               && (   !name.compare(name.size() - 5, 5, ".rtbw")
+                   || !name.compare(name.size() - 5, 5, ".rtbz"));
+    };
+
+#ifndef _WIN32
+    DIR* d = opendir(dir.c_str());
+
+    if (!d)
+        return names;
+
+    while (dirent* e = readdir(d))
+        if (isTable(e->d_name))
+            names.push_back(e->d_name);
+
+    closedir(d);
+#else
+    WIN32_FIND_DATA data;
+    HANDLE h = FindFirstFile((dir + "\\*").c_str(), &data);
+
+    if (h == INVALID_HANDLE_VALUE)
+        return names;
+
+    do
+        if (isTable(data.cFileName))
+            names.push_back(data.cFileName);
+    while (FindNextFile(h, &data));
+
+    FindClose(h);
+#endif
+    return names;
+}
+
+
+// TBFile::scan() fills Files with one directory listing per path. When an index
+// file is given, the listing of every directory whose modification time is
+// unchanged since it was last written is taken from the index instead, which
+// avoids scanning large or network-mounted stores at every start. The index is
+// a text file with a "@<mtime> <directory>" line followed by the file names for
+// each directory, and it is rewritten whenever a listing is refreshed.
+void TBFile::scan(const std::string& indexFile) {
+
+#ifndef _WIN32
+    constexpr char SepChar = ':';
+#else
+    constexpr char SepChar = ';';
+#endif
+
+    std::map<std::string, std::pair<uint64_t, std::vector<std::string>>> index;
+    bool useIndex = !indexFile.empty() && indexFile != "<empty>";
+    bool dirty = false;
+
+    if (useIndex)
+    {
+        std::ifstream in(indexFile);
+        std::vector<std::string>* names = nullptr;
+        std::string line;
+
+        while (std::getline(in, line))
+            if (line.size() > 1 && line[0] == '@')
+            {
+                size_t sep = line.find(' ');
+
+                if (sep == std::string::npos)
+                    break;
+
+                // A corrupt entry is skipped, its directory is listed again
+                char* last;
+                uint64_t mtime = std::strtoull(line.c_str() + 1, &last, 10);
+                names = nullptr;
+
+                if (!isdigit(line[1]) || last != line.c_str() + sep || mtime == ULLONG_MAX)
+                    continue;
+
+                auto& entry = index[line.substr(sep + 1)];
+                entry.first = mtime;
+                entry.second.clear();
+                names = &entry.second;
+            }
+            else if (names && !line.empty())
+                names->push_back(line);
+    }
+
+    Files.clear();
+
+    std::stringstream ss(Paths);
+    std::string path;
+
+    while (std::getline(ss, path, SepChar)) {
+
+        uint64_t mtime = dir_mtime(path);
+
+        if (!mtime)
+            continue;
+
+        auto& entry = index[path];
+
+        if (!useIndex || entry.first != mtime)
+        {
+            entry = std::make_pair(mtime, list_tables(path));
+            dirty = true;
+        }
+
+        for (const std::string& name : entry.second)
+            Files.emplace(name, path + "/" + name);
+    }
+
+    if (useIndex && dirty)
+    {
+        std::ofstream out(indexFile);
+
+        for (auto& entry : index)
+        {
+            out << '@' << entry.second.first << ' ' << entry.first << '\n';
+
+            for (const std::string& name : entry.second.second)
+                out << name << '\n';
+        }
+    }
+}
 
 // struct PairsData contains low level indexing information to access TB data.
 // There are 8, 4 or 2 PairsData records for each TBTable, according to type of
@@ -405,6 +568,17 @@ class TBTables {
         exit(1);
     }
 
+    template<TBType Type>
+    static void mapped(const std::deque<TBTable<Type>>& tables, size_t& mapped, size_t& resident) {
+        for (const TBTable<Type>& e : tables)
+            if (e.ready.load(std::memory_order_acquire) && e.baseAddress) {
+#ifndef _WIN32
+                mapped += e.mapping;
+                resident += resident_bytes(e.baseAddress, e.mapping);
+#endif
+            }
+    }
+
 public:
     template<TBType Type>
     TBTable<Type>* get(Key key) {
@@ -420,28 +594,26 @@ public:
         dtzTable.clear();
     }
     size_t size() const { return wdlTable.size(); }
-    void add(const std::vector<PieceType>& pieces);
+
+    // Memory of the tables and hash index, and of the files mapped so far
+    void memory(size_t& used, size_t& mappedBytes, size_t& resident) const {
+        used = sizeof(*this) + wdlTable.size() * sizeof(TBTable<WDL>)
+                             + dtzTable.size() * sizeof(TBTable<DTZ>);
+        mappedBytes = resident = 0;
+        mapped(wdlTable, mappedBytes, resident);
+        mapped(dtzTable, mappedBytes, resident);
+    }
+    void add(const std::string& code);
 };
 
 TBTables TBTables;
 
-// If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
-// are created and added to the lists and hash table. Called at init time.
-void TBTables::add(const std::vector<PieceType>& pieces) {
-
-    std::string code;
-
-    for (PieceType pt : pieces)
-        code += PieceToChar[pt];
-
-    TBFile file(code.insert(code.find('K', 1), "v") + ".rtbw"); // KRK -> KRvK
+// Two new objects TBTable<WDL> and TBTable<DTZ> are created for the given code,
+// like "KRvK", and added to the lists and hash table. Called at init time for
+// every .rtbw file found.
+void TBTables::add(const std::string& code) {
 
-    if (!file.is_open()) // Only WDL file is checked
-        return;
-
-    file.close();
-
-    MaxCardinality = std::max((int)pieces.size(), MaxCardinality);
+    MaxCardinality = std::max((int)code.size() - 1, MaxCardinality);
 
     wdlTable.emplace_back(code);
     dtzTable.emplace_back(wdlTable.back());
@@ -1200,6 +1372,14 @@ WDLScore search(Position& pos, ProbeState* result) {
 } // namespace
 
 
+/// Tablebases::memory() reports the memory used by the table descriptions and
+/// hash index, the bytes of the files mapped so far and how many of them are
+/// resident. File mappings are not measured on Windows.
+void Tablebases::memory(size_t& used, size_t& mapped, size_t& resident) {
+    TBTables.memory(used, mapped, resident);
+}
+
+
 /// Tablebases::init() is called at startup and after every change to
 /// "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 /// safe, nor it needs to be.
@@ -1306,31 +1486,26 @@ void Tablebases::init(const std::string& paths) {
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
 
-    // Add entries in TB tables if the corresponding ".rtbw" file exsists
-    for (PieceType p1 = PAWN; p1 < KING; ++p1) {
-        TBTables.add({KING, p1, KING});
-
-        for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
-            TBTables.add({KING, p1, p2, KING});
-            TBTables.add({KING, p1, KING, p2});
-
-            for (PieceType p3 = PAWN; p3 < KING; ++p3)
-                TBTables.add({KING, p1, p2, KING, p3});
+    // Add entries in TB tables for every well formed ".rtbw" file found, like
+    // "KRPvKR.rtbw", instead of probing the file system for each combination.
+    TBFile::scan(Options["SyzygyIndex"]);
 
-            for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
-                TBTables.add({KING, p1, p2, p3, KING});
-
-                for (PieceType p4 = PAWN; p4 <= p3; ++p4)
-                    TBTables.add({KING, p1, p2, p3, p4, KING});
-
-                for (PieceType p4 = PAWN; p4 < KING; ++p4)
-                    TBTables.add({KING, p1, p2, p3, KING, p4});
-            }
+    for (auto& f : TBFile::Files)
+    {
+        const std::string& name = f.first;
+        std::string tb = name.substr(0, name.size() - 5);
+        size_t v = tb.find('v');
+
+        if (   name.compare(name.size() - 5, 5, ".rtbw")
+            || (int)tb.size() - 1 > TBPIECES
+            || v == std::string::npos
+            || tb[0] != 'K' || tb[v + 1] != 'K'
+            || tb.find_first_not_of("KQRBNPv") != std::string::npos
+            || std::count(tb.begin(), tb.end(), 'K') != 2
+            || std::count(tb.begin(), tb.end(), 'v') != 1)
+            continue;
 
-            for (PieceType p3 = PAWN; p3 <= p1; ++p3)
-                for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
-                    TBTables.add({KING, p1, p2, KING, p3, p4});
-        }
+        TBTables.add(tb);
     }
 
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
@@ -1439,49 +1614,93 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 }
 
 
+namespace {
+
+// probe_root_moves() calls probe(pos, m) for every root move m. When there are
+// several search threads, the moves are dealt out to as many helper threads,
+// each probing on its own copy of the root position. Every move is probed by
+// exactly one of them and ranked in place, so the result does not depend on
+// the scheduling. A return value false indicates that a probe failed.
+template<typename F>
+bool probe_root_moves(Position& pos, Search::RootMoves& rootMoves, F probe) {
+
+    const size_t threadCount = std::min(Threads.size(), rootMoves.size());
+
+    if (threadCount <= 1)
+        return std::all_of(rootMoves.begin(), rootMoves.end(),
+                           [&](Search::RootMove& m) { return probe(pos, m); });
+
+    const std::string fen = pos.fen();
+    std::atomic<bool> success(true);
+    std::vector<std::thread> threads;
+
+    for (size_t idx = 0; idx < threadCount; idx++)
+        threads.push_back(std::thread([&, idx]() {
+            if (Options["Threads"] >= 8)
+                WinProcGroup::bindThisThread(idx);
+
+            StateInfo st;
+            Position p;
+            p.set(fen, pos.is_chess960(), &st, Threads[idx]);
+
+            for (size_t i = idx; i < rootMoves.size() && success; i += threadCount)
+                if (!probe(p, rootMoves[i]))
+                    success = false;
+        }));
+
+    for (std::thread& th: threads)
+        th.join();
+
+    return success;
+}
+
+} // namespace
+
+
 // Use the DTZ tables to rank root moves.
 //
 // A return value false indicates that not all probes were successful.
 bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
 
-    ProbeState result;
-    StateInfo st;
-
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
 
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = Options["Syzygy50MoveRule"] ? 900 : 1;
+    int bound = Options["Syzygy50MoveRule"] ? 900 : 1;
 
     // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    return probe_root_moves(pos, rootMoves, [=](Position& p, Search::RootMove& m) {
+
+        ProbeState result;
+        StateInfo st;
+        int dtz;
+
+        p.do_move(m.pv[0], st);
 
         // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
+        if (p.rule50_count() == 0)
         {
             // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
+            WDLScore wdl = -probe_wdl(p, &result);
             dtz = dtz_before_zeroing(wdl);
         }
         else
         {
             // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
+            dtz = -probe_dtz(p, &result);
             dtz =  dtz > 0 ? dtz + 1
                  : dtz < 0 ? dtz - 1 : dtz;
         }
 
         // Make sure that a mating move is assigned a dtz value of 1
-        if (   pos.checkers()
+        if (   p.checkers()
             && dtz == 2
-            && MoveList<LEGAL>(pos).size() == 0)
+            && MoveList<LEGAL>(p).size() == 0)
             dtz = 1;
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1501,9 +1720,8 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
                    : r == 0     ? VALUE_DRAW
                    : r > -bound ? Value((std::min(-3, r + 800) * int(PawnValueEg)) / 200)
                    :             -VALUE_MATE + MAX_PLY + 1;
-    }
-
-    return true;
+        return true;
+    });
 }
 
 
@@ -1515,19 +1733,19 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves) {
 
     static const int WDL_to_rank[] = { -1000, -899, 0, 899, 1000 };
 
-    ProbeState result;
-    StateInfo st;
-
     bool rule50 = Options["Syzygy50MoveRule"];
 
     // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    return probe_root_moves(pos, rootMoves, [=](Position& p, Search::RootMove& m) {
+
+        ProbeState result;
+        StateInfo st;
 
-        WDLScore wdl = -probe_wdl(pos, &result);
+        p.do_move(m.pv[0], st);
 
-        pos.undo_move(m.pv[0]);
+        WDLScore wdl = -probe_wdl(p, &result);
+
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1538,7 +1756,6 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves) {
             wdl =  wdl > WDLDraw ? WDLWin
                  : wdl < WDLDraw ? WDLLoss : WDLDraw;
         m.tbScore = WDL_to_value[wdl + 2];
-    }
-
-    return true;
+        return true;
+    });
 }
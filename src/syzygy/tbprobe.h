@@ -52,6 +52,7 @@ int probe_dtz(Position& pos, ProbeState* result);
 bool root_probe(Position& pos, Search::RootMoves& rootMoves);
 bool root_probe_wdl(Position& pos, Search::RootMoves& rootMoves);
 void rank_root_moves(Position& pos, Search::RootMoves& rootMoves);
+void memory(size_t& used, size_t& mapped, size_t& resident);
 
 inline std::ostream& operator<<(std::ostream& os, const WDLScore v) {
 
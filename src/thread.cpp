@@ -20,10 +20,14 @@
 
 #include <algorithm> // For std::count
 #include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
 
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
+#include "timeman.h"
 #include "uci.h"
 #include "syzygy/tbprobe.h"
 #include "tt.h"
@@ -34,8 +38,16 @@ ThreadPool Threads; // Global object
 /// Thread constructor launches the thread and waits until it goes to sleep
 /// in idle_loop(). Note that 'searching' and 'exit' should be alredy set.
 
-Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
+Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this),
+                           histories(new_table<ThreadHistories>("history tables")),
+                           counterMoves(histories->counterMoves),
+                           mainHistory(histories->mainHistory),
+                           captureHistory(histories->captureHistory),
+                           contHistory(histories->contHistory),
+                           moveListCache(Options["MoveList Cache"] ? new_table<MoveListCache>("move list cache")
+                                                                   : nullptr) {
 
+  qsearchTT.resize(Options["QSearch Hash"]);
   wait_for_search_finished();
 }
 
@@ -50,10 +62,55 @@ Thread::~Thread() {
   exit = true;
   start_searching();
   stdThread.join();
+
+  histories->~ThreadHistories();
+  std_aligned_free(histories);
+
+  if (moveListCache)
+  {
+      moveListCache->~MoveListCache();
+      std_aligned_free(moveListCache);
+  }
+}
+
+
+/// Thread::operator new() and operator delete() honour the cache line alignment
+/// of Thread, that the default allocator does not guarantee before C++17.
+
+void* Thread::operator new(size_t size) {
+
+  void* mem = std_aligned_alloc(alignof(Thread), size);
+
+  if (!mem)
+  {
+      std::cerr << "Failed to allocate thread." << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+
+  return mem;
+}
+
+void Thread::operator delete(void* ptr) { std_aligned_free(ptr); }
+
+
+/// Thread::new_table() allocates a big per-thread table page aligned
+
+template<typename T>
+T* Thread::new_table(const char* name) {
+
+  void* mem = std_aligned_alloc(PageSize, sizeof(T));
+
+  if (!mem)
+  {
+      std::cerr << "Failed to allocate " << name << "." << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+
+  return new (mem) T;
 }
 
 
-/// Thread::clear() reset histories, usually before a new game
+/// Thread::clear() reset histories and the qsearch table, usually before a new game
 
 void Thread::clear() {
 
@@ -66,6 +123,12 @@ void Thread::clear() {
           h.get()->fill(0);
 
   contHistory[NO_PIECE][0].get()->fill(Search::CounterMovePruneThreshold - 1);
+
+  if (moveListCache)
+      moveListCache->clear();
+
+  if (qsearchTT.enabled())
+      qsearchTT.clear();
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -93,6 +156,8 @@ void Thread::wait_for_search_finished() {
 
 void Thread::idle_loop() {
 
+  osThreadId = os_thread_id();
+
   // If OS already scheduled us on a different group than 0 then don't overwrite
   // the choice, eventually we are one of many one-threaded processes running on
   // some Windows NUMA hardware, for instance in fishtest. To make it simple,
@@ -128,6 +193,9 @@ void ThreadPool::set(size_t requested) {
 
       while (size() > 0)
           delete back(), pop_back();
+
+      // Shared material entries point to the destroyed threads' endgames
+      Material::clear();
   }
 
   if (requested > 0) { // create new thread(s)
@@ -152,6 +220,54 @@ void ThreadPool::clear() {
   main()->callsCnt = 0;
   main()->previousScore = VALUE_INFINITE;
   main()->previousTimeReduction = 1.0;
+  main()->previousPv.clear();
+  newGame = true;
+}
+
+
+/// ThreadPool::auto_hash() returns the size of the hash in megabytes, if "Auto
+/// Hash" is enabled, from the expected length of the searches of a game and the
+/// memory available, or 0 if the search has no time or node budget. The search
+/// length is the optimum time of TimeManagement at the speed of the last timed
+/// search, or a default speed for each thread. Infinite analysis gets the
+/// biggest table that fits.
+
+size_t ThreadPool::auto_hash(const Position& pos, const Search::LimitsType& limits) const {
+
+  constexpr uint64_t DefaultThreadNps = 1000000;
+
+  if (!Options["Auto Hash"])
+      return 0;
+
+  uint64_t speed = nps ? nps : DefaultThreadNps * size();
+  uint64_t nodes;
+
+  if (limits.use_time_management())
+  {
+      Search::LimitsType l = limits;
+      TimeManagement tm;
+      tm.availableNodes = 0;
+      tm.init(l, pos.side_to_move(), pos.game_ply());
+      nodes = l.npmsec ? uint64_t(tm.optimum()) : tm.optimum() * speed / 1000;
+  }
+  else if (limits.movetime)
+      nodes = limits.movetime * speed / 1000;
+  else if (limits.nodes)
+      nodes = limits.nodes;
+  else if (limits.infinite)
+      nodes = UINT64_MAX;
+  else
+      return 0;
+
+  size_t available = available_memory();
+  size_t mbSize = TT.auto_size(nodes, available);
+
+  sync_cout << (Options["Protocol"] == "xboard" ? "# " : "info string ")
+            << "Hash " << mbSize << " MB for "
+            << (nodes == UINT64_MAX ? "analysis" : std::to_string(nodes / 1000) + "k nodes per search")
+            << ", available memory " << available / (1024 * 1024) << " MB" << sync_endl;
+
+  return mbSize;
 }
 
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
@@ -165,6 +281,20 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   stopOnPonderhit = stop = false;
   ponder = ponderMode;
   Search::Limits = limits;
+
+  // Resizing clears the table, which can take a while for big tables. The clock
+  // of a timed search is already running, so its size is kept for the next game.
+  if (newGame)
+  {
+      size_t mbSize = auto_hash(pos, limits);
+      newGame = false;
+
+      if (limits.use_time_management() || limits.movetime)
+          nextHashMB = mbSize;
+      else if (mbSize && mbSize != size_t(Options["Hash"]))
+          Options["Hash"] = std::to_string(mbSize);
+  }
+
   Search::RootMoves rootMoves;
 
   for (const auto& m : MoveList<LEGAL>(pos))
@@ -175,6 +305,11 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (!rootMoves.empty())
       Tablebases::rank_root_moves(pos, rootMoves);
 
+  // Must be done before the ownership transfer below, that releases the
+  // states of the previous root.
+  Depth startDepth = rootMoves.empty() ? DEPTH_ZERO
+                                       : main()->continuation(pos, rootMoves);
+
   // After ownership transfer 'states' becomes empty, so if we stop the search
   // and call 'go' again without setting a new position states.get() == NULL.
   assert(states.get() || setupStates.get());
@@ -192,12 +327,19 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = 0;
-      th->rootDepth = th->completedDepth = DEPTH_ZERO;
+      th->rootDepth = startDepth;
+      th->completedDepth = DEPTH_ZERO;
       th->rootMoves = rootMoves;
       th->rootPos.set(pos.fen(), pos.is_chess960(), &setupStates->back(), th);
   }
 
+  // Keep the king danger map computed by set(), so that the threads only read
+  // the shared root state.
+  tmp.kingDanger = setupStates->back().kingDanger;
   setupStates->back() = tmp;
 
+  for (Thread* th : *this)
+      th->rootPos.init_key_filter();
+
   main()->start_searching();
 }
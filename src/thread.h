@@ -33,12 +33,27 @@
 #include "position.h"
 #include "search.h"
 #include "thread_win32.h"
+#include "tt.h"
+
+
+/// ThreadHistories groups the per-thread move ordering tables. They are big,
+/// so they are allocated apart from the Thread object on page boundaries, as
+/// the MoveListCache when enabled.
+
+struct ThreadHistories {
+  CounterMoveHistory counterMoves;
+  ButterflyHistory mainHistory;
+  CapturePieceToHistory captureHistory;
+  ContinuationHistory contHistory;
+};
 
 
 /// Thread class keeps together all the thread-related stuff. We use
 /// per-thread pawn and material hash tables so that once we get a
 /// pointer to an entry its life time is unlimited and we don't have
-/// to care about someone changing the entry under our feet.
+/// to care about someone changing the entry under our feet. Fields
+/// updated at every node live on cache lines of their own, so that other
+/// threads reading the node counters do not slow down the search.
 
 class Thread {
 
@@ -48,6 +63,8 @@ class Thread {
   bool exit = false, searching = true; // Set before starting std::thread
   std::thread stdThread;
 
+  template<typename T> static T* new_table(const char* name);
+
 public:
   explicit Thread(size_t);
   virtual ~Thread();
@@ -57,23 +74,38 @@ public:
   void start_searching();
   void wait_for_search_finished();
 
-  Pawns::Table pawnsTable;
-  Material::Table materialTable;
-  Endgames endgames;
-  size_t pvIdx, pvLast;
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
+  // Written by the owning thread, read by the others
+  alignas(CacheLineSize) std::atomic<uint64_t> nodes, tbHits;
+
+  // Written and read only by the owning thread
+  alignas(CacheLineSize) size_t pvIdx, pvLast;
   int selDepth, nmpMinPly;
   Color nmpColor;
-  std::atomic<uint64_t> nodes, tbHits;
+  Depth rootDepth, completedDepth;
+
+  // Repetition filter of the search: number of positions on the path of the
+  // root position, including the game history, by the low bits of their key.
+  static constexpr int KeyFilterSize = 4096;
+  uint16_t keyFilter[KeyFilterSize] = {};
 
+  alignas(CacheLineSize) Pawns::Table pawnsTable;
+  Material::Table materialTable;
+  TranspositionTable qsearchTT;
+  Endgames endgames;
   Position rootPos;
   Search::RootMoves rootMoves;
-  Depth rootDepth, completedDepth;
-  CounterMoveHistory counterMoves;
-  ButterflyHistory mainHistory;
-  CapturePieceToHistory captureHistory;
-  ContinuationHistory contHistory;
+  ThreadHistories* histories;
+  CounterMoveHistory& counterMoves;
+  ButterflyHistory& mainHistory;
+  CapturePieceToHistory& captureHistory;
+  ContinuationHistory& contHistory;
+  MoveListCache* moveListCache; // Allocated only if the cache is enabled
   Score contempt;
   Thread* bestThread; // to fetch best move when in XBoard mode
+  int osThreadId;      // Kernel id of the thread, set in idle_loop()
 };
 
 
@@ -85,10 +117,14 @@ struct MainThread : public Thread {
 
   void search() override;
   void check_time();
+  Depth continuation(const Position& pos, Search::RootMoves& rms);
 
   double bestMoveChanges, previousTimeReduction;
   Value previousScore;
   int callsCnt;
+  std::vector<Move> previousPv;
+  Depth previousDepth;
+  Key previousRootKey;
 };
 
 
@@ -101,12 +137,17 @@ struct ThreadPool : public std::vector<Thread*> {
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
   void clear();
   void set(size_t);
+  size_t auto_hash(const Position&, const Search::LimitsType&) const;
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
 
   std::atomic_bool stop, ponder, stopOnPonderhit;
+  uint64_t nps = 0;      // Speed of the last timed search, 0 if not known yet
+  bool newGame = true;   // No search since clear(), the hash can be resized
+  size_t nextHashMB = 0; // Hash size chosen by a timed search, for the next game
+
 
   StateListPtr setupStates;
 
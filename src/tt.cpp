@@ -18,6 +18,7 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cstring>   // For std::memset
 #include <iostream>
 #include <thread>
@@ -33,12 +34,18 @@ TranspositionTable TT; // Our global transposition table
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// A size of zero releases the table, that is then disabled.
 
 void TranspositionTable::resize(size_t mbSize) {
 
   clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
   free(mem);
+  mem = nullptr;
+
+  if (!clusterCount)
+      return;
+
   mem = malloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1);
 
   if (!mem)
@@ -53,19 +60,43 @@ void TranspositionTable::resize(size_t mbSize) {
 }
 
 
+/// TranspositionTable::auto_size() returns a table size in megabytes, a power of
+/// two big enough to store every node of a search of the given number of nodes,
+/// but at least 16 MB. It never takes more than half of the given available
+/// memory, 0 if not known, counting the current table as available.
+
+size_t TranspositionTable::auto_size(uint64_t nodes, size_t available) const {
+
+  uint64_t budget = available ? (uint64_t(available) + size_bytes()) / 2 : UINT64_MAX;
+  uint64_t needed = nodes / ClusterSize * sizeof(Cluster);
+  size_t mbSize = 16;
+
+  while (mbSize < MaxHashMB && (uint64_t(mbSize) << 20) < needed)
+      mbSize *= 2;
+
+  while (mbSize > 1 && (uint64_t(mbSize) << 20) > budget)
+      mbSize /= 2;
+
+  return mbSize;
+}
+
+
 /// TranspositionTable::clear() overwrites the entire transposition table
 /// with zeros. It is called whenever the table is resized, or when the
 /// user asks the program to clear the table (from the UCI interface).
-/// It starts as many threads as allowed by the Threads option.
+/// It starts as many threads as allowed by the Threads option, but not more
+/// than one for every 16MB, so that small tables are cleared by a single one.
 
 void TranspositionTable::clear() {
 
-  const size_t stride = clusterCount / Options["Threads"];
+  const size_t threadCount = std::min(size_t(Options["Threads"]),
+                                      1 + clusterCount * sizeof(Cluster) / (16 * 1024 * 1024));
+  const size_t stride = clusterCount / threadCount;
   std::vector<std::thread> threads;
-  for (size_t idx = 0; idx < Options["Threads"]; idx++)
+  for (size_t idx = 0; idx < threadCount; idx++)
   {
       const size_t start =  stride * idx,
-                   len =    idx != Options["Threads"] - 1 ?
+                   len =    idx != threadCount - 1 ?
                             stride :
                             clusterCount - start;
       threads.push_back(std::thread([this, idx, start, len]() {
@@ -85,7 +85,6 @@ private:
 
 class TranspositionTable {
 
-  static constexpr int CacheLineSize = 64;
   static constexpr int ClusterSize = 3;
 
   struct Cluster {
@@ -96,12 +95,19 @@ class TranspositionTable {
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
 
 public:
+  // At most 2^32 clusters
+  static constexpr size_t MaxHashMB = Is64Bit ? 131072 : 2048;
+
  ~TranspositionTable() { free(mem); }
+  bool enabled() const { return clusterCount > 0; }
   void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
+  size_t size_bytes() const { return clusterCount * sizeof(Cluster); }
+  size_t resident() const { return resident_bytes(table, size_bytes()); }
   void resize(size_t mbSize);
+  size_t auto_size(uint64_t nodes, size_t available) const;
   void clear();
 
   // The 32 lowest order bits of the key are used to get the index of the cluster
@@ -110,10 +116,10 @@ public:
   }
 
 private:
-  size_t clusterCount;
-  Cluster* table;
-  void* mem;
-  uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  size_t clusterCount = 0;
+  Cluster* table = nullptr;
+  void* mem = nullptr;
+  uint8_t generation8 = 0; // Size must be not bigger than TTEntry::genBound8
 };
 
 extern TranspositionTable TT;
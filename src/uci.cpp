@@ -18,13 +18,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 #include <string>
 
 #include "evaluate.h"
 #include "movegen.h"
+#include "pgn.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
@@ -47,12 +55,16 @@ namespace {
   // position() is called when engine receives the "position" UCI command.
   // The function sets up the position described in the given FEN string ("fen")
   // or the starting position ("startpos") and then makes the moves given in the
-  // following move list ("moves").
+  // following move list ("moves"). The moves made are appended to 'moves' if
+  // given.
 
-  void position(Position& pos, istringstream& is, StateListPtr& states) {
+  void position(Position& pos, istringstream& is, StateListPtr& states,
+                vector<Move>* moves = nullptr) {
 
     Move m;
     string token, fen;
+    PackedPosition packed;
+    bool isPacked = false;
 
     is >> token;
 
@@ -64,17 +76,31 @@ namespace {
     else if (token == "fen")
         while (is >> token && token != "moves")
             fen += token + " ";
+    else if (token == "packed")
+    {
+        if (!(is >> token) || !packed.from_hex(token))
+            return;
+        isPacked = true;
+        is >> token; // Consume "moves" token if any
+    }
     else
         return;
 
     states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+
+    if (isPacked)
+        pos.set(packed, Options["UCI_Chess960"], &states->back(), Threads.main());
+    else
+        pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
 
     // Parse move list (if any)
     while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
     {
         states->emplace_back();
         pos.do_move(m, states->back());
+
+        if (moves)
+            moves->push_back(m);
     }
   }
 
@@ -103,18 +129,14 @@ namespace {
   }
 
 
-  // go() is called when engine receives the "go" UCI command. The function sets
-  // the thinking time and other parameters from the input string, then starts
-  // the search.
+  // parse_limits() reads the search limits of a "go" command and returns
+  // whether the search starts in ponder mode.
 
-  void go(Position& pos, istringstream& is, StateListPtr& states) {
+  bool parse_limits(const Position& pos, istream& is, Search::LimitsType& limits) {
 
-    Search::LimitsType limits;
     string token;
     bool ponderMode = false;
 
-    limits.startTime = now(); // As early as possible!
-
     while (is >> token)
         if (token == "searchmoves")
             while (is >> token)
@@ -133,41 +155,534 @@ namespace {
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
+    return ponderMode;
+  }
+
+
+  // go() is called when engine receives the "go" UCI command. The function sets
+  // the thinking time and other parameters from the input string, then starts
+  // the search.
+
+  void go(Position& pos, istringstream& is, StateListPtr& states) {
+
+    Search::LimitsType limits;
+
+    limits.startTime = now(); // As early as possible!
+
+    bool ponderMode = parse_limits(pos, is, limits);
+
     Threads.start_thinking(pos, states, limits, ponderMode);
   }
 
 
-  // bench() is called when engine receives the "bench" command. Firstly
-  // a list of UCI commands is setup according to bench parameters, then
-  // it is run one by one printing a summary at the end.
+  // next_line() finds the next non-blank line of a mapped file, starting at p.
+  // It returns false at the end of the file.
 
-  void bench(Position& pos, istream& args, StateListPtr& states) {
+  bool next_line(const char*& p, const char* end, const char*& begin, const char*& last) {
 
-    string token;
+    while (p < end)
+    {
+        begin = p;
+        const char* eol = find(p, end, '\n');
+        p = eol + (eol < end);
+
+        for (last = eol; last > begin && isspace(last[-1]); --last) {}
+        while (begin < last && isspace(*begin))
+            ++begin;
+
+        if (begin < last)
+            return true;
+    }
+    return false;
+  }
+
+
+  // run_fen_file() searches with the given limits each position of a file of
+  // FEN or EPD lines. The lines are parsed in place in the mapped file, with
+  // an optional move list after "moves" as in the position command. Lines
+  // with a setoption command are also accepted.
+
+  uint64_t run_fen_file(Position& pos, const string& fname, const Search::LimitsType& goLimits,
+                        StateListPtr& states, PerfCounters* perf) {
+
+    MappedFile file(fname);
+
+    if (!file.is_open())
+    {
+        cerr << "Unable to open file " << fname << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const char *p, *end = file.data() + file.size(), *begin, *last;
+    const string Setoption = "setoption", Moves = " moves ";
+    uint64_t num = 0, nodes = 0, cnt = 1;
+    string fen, token;
+    Move m;
+
+    auto is_setoption = [&](const char* b, const char* e) {
+        return size_t(e - b) > Setoption.size() && equal(Setoption.begin(), Setoption.end(), b);
+    };
+
+    for (p = file.data(); next_line(p, end, begin, last); )
+        num += !is_setoption(begin, last);
+
+    for (p = file.data(); next_line(p, end, begin, last); )
+    {
+        if (is_setoption(begin, last))
+        {
+            istringstream is(string(begin + Setoption.size(), last));
+            setoption(is);
+            continue;
+        }
+
+        const char* moves = std::search(begin, last, Moves.begin(), Moves.end());
+
+        fen.assign(begin, moves);
+        states = StateListPtr(new std::deque<StateInfo>(1));
+        pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+
+        // Parse move list (if any)
+        for (const char* t = moves + (moves < last) * Moves.size(); t < last; )
+        {
+            const char* te = find_if(t, last, [](char c) { return isspace(c); });
+            token.assign(t, te);
+            if ((m = UCI::to_move(pos, token)) == MOVE_NONE)
+                break;
+
+            states->emplace_back();
+            pos.do_move(m, states->back());
+            t = find_if(te, last, [](char c) { return !isspace(c); });
+        }
+
+        Search::LimitsType limits = goLimits;
+        limits.startTime = now();
+
+        cerr << "\nPosition: " << cnt++ << '/' << num << endl;
+
+        if (perf)
+            perf->start();
+
+        Threads.start_thinking(pos, states, limits, false);
+        Threads.main()->wait_for_search_finished();
+
+        if (perf)
+            perf->stop();
+
+        nodes += Threads.nodes_searched();
+    }
+
+    return nodes;
+  }
+
+
+  // run_bench() runs one by one the UCI commands of a bench list, returning
+  // the number of nodes searched. A "fenfile" command makes the following go
+  // command run on each position of the file. The searches are measured with
+  // the performance counters, if given.
+
+  uint64_t run_bench(Position& pos, const vector<string>& list, StateListPtr& states,
+                     PerfCounters* perf = nullptr) {
+
+    string token, fenFile;
     uint64_t num, nodes = 0, cnt = 1;
 
-    vector<string> list = setup_bench(pos, args);
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0; });
 
-    TimePoint elapsed = now();
-
     for (const auto& cmd : list)
     {
         istringstream is(cmd);
         is >> skipws >> token;
 
-        if (token == "go")
+        if (token == "go" && !fenFile.empty())
+        {
+            Search::LimitsType limits;
+            parse_limits(pos, is, limits);
+            nodes += run_fen_file(pos, fenFile, limits, states, perf);
+        }
+        else if (token == "go")
         {
             cerr << "\nPosition: " << cnt++ << '/' << num << endl;
+
+            if (perf)
+                perf->start();
+
             go(pos, is, states);
             Threads.main()->wait_for_search_finished();
+
+            if (perf)
+                perf->stop();
+
             nodes += Threads.nodes_searched();
         }
         else if (token == "setoption")  setoption(is);
         else if (token == "position")   position(pos, is, states);
+        else if (token == "fenfile")    is >> fenFile;
         else if (token == "ucinewgame") Search::clear();
     }
 
+    return nodes;
+  }
+
+
+  // analyze_game() is called on "analyzegame startpos|fen <fen>|packed <hex>
+  // moves <moves> [go <limits>]". It searches every position of the game with
+  // the given limits, depth 12 by default, from the last one back to the first
+  // without clearing the hash between them, so that what was found for the
+  // later positions guides the searches of the earlier ones. The searches are
+  // silent, only a line with the score, best move and played move is printed
+  // for each ply. The position is left at the end of the game, as with the
+  // position command.
+
+  void analyze_game(Position& pos, istringstream& is, StateListPtr& states) {
+
+    vector<Move> moves;
+    Search::LimitsType goLimits;
+
+    position(pos, is, states, &moves);
+    parse_limits(pos, is, goLimits);
+
+    if (!goLimits.depth && !goLimits.nodes && !goLimits.movetime)
+        goLimits.depth = 12;
+
+    // Take back the game to get its starting position
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it)
+        pos.undo_move(*it);
+
+    const string fen = pos.fen();
+    uint64_t nodes = 0;
+    TimePoint elapsed = now();
+
+    // Sets the position after the given number of plies of the game
+    auto set_ply = [&](int ply) {
+        states = StateListPtr(new std::deque<StateInfo>(1));
+        pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+
+        for (int i = 0; i < ply; ++i)
+        {
+            states->emplace_back();
+            pos.do_move(moves[i], states->back());
+        }
+    };
+
+    Search::clear();
+
+    for (int ply = int(moves.size()); ply >= 0; --ply)
+    {
+        set_ply(ply);
+
+        Move played = ply < int(moves.size()) ? moves[ply] : MOVE_NONE;
+        Move best = MOVE_NONE;
+        Value score = pos.checkers() ? -VALUE_MATE : VALUE_DRAW;
+        int depth = 0;
+        uint64_t plyNodes = 0;
+        TimePoint plyTime = now();
+
+        if (MoveList<LEGAL>(pos).size())
+        {
+            Search::LimitsType limits = goLimits;
+            limits.startTime = now();
+            limits.silent = true;
+
+            Threads.start_thinking(pos, states, limits, false);
+            Threads.main()->wait_for_search_finished();
+
+            const Thread* th = Threads.main()->bestThread;
+            best = th->rootMoves[0].pv[0];
+            score = th->rootMoves[0].score;
+            depth = th->completedDepth / ONE_PLY;
+            nodes += plyNodes = Threads.nodes_searched();
+        }
+
+        sync_cout << "analysis ply " << ply
+                  << " move "        << UCI::move(played, pos)
+                  << " bestmove "    << UCI::move(best, pos)
+                  << " score "       << UCI::value(score)
+                  << " depth "       << depth
+                  << " nodes "       << plyNodes
+                  << " time "        << now() - plyTime << sync_endl;
+    }
+
+    set_ply(int(moves.size()));
+
+    sync_cout << "analysis plies " << moves.size()
+              << " nodes "         << nodes
+              << " time "          << now() - elapsed << sync_endl;
+  }
+
+
+  // read_pgn() is called on "pgn <file> [threads] [moves] [check]". It reads
+  // the games of a PGN file with the given number of threads, at most and by
+  // default as many as the search threads, and reports the number of games, moves and
+  // errors with the reading rate. With "moves" every game is also printed as a
+  // position command. With "check" every legal move of every position of the
+  // games is converted to SAN and back, and the moves that do not come back
+  // unchanged are reported.
+
+  void read_pgn(istringstream& is) {
+
+    string fname, token;
+    size_t threadCount = Threads.size();
+    bool print = false, check = false;
+
+    is >> fname;
+
+    while (is >> token)
+        if (token == "moves")
+            print = true;
+        else if (token == "check")
+            check = true;
+        else if (   token.find_first_not_of("0123456789") == string::npos
+                 && token.size() < 4 && stoi(token) > 0)
+            threadCount = size_t(stoi(token));
+        else
+        {
+            cerr << "Usage: pgn <file> [threads] [moves] [check]" << endl;
+            return;
+        }
+
+    // Every reading thread binds its positions to a search thread of its own,
+    // so a running search is stopped first.
+    threadCount = std::min(threadCount, Threads.size());
+    Threads.stop = true;
+    Threads.main()->wait_for_search_finished();
+
+    std::atomic<uint64_t> plies(0), errors(0), mismatches(0);
+    TimePoint elapsed = now();
+
+    uint64_t games = PGN::read(fname, threadCount, [&](size_t idx, const PGN::Game& game) {
+
+        plies += game.moves.size();
+        errors += game.error;
+
+        if (!print && !check)
+            return;
+
+        std::deque<StateInfo> states(1);
+        Position pos;
+        string cmd = "position fen " + game.fen + " moves";
+
+        pos.set(game.fen, game.chess960, &states.back(), Threads[idx]);
+
+        for (size_t i = 0; i <= game.moves.size(); ++i)
+        {
+            if (check)
+                for (const auto& m : MoveList<LEGAL>(pos))
+                {
+                    string san = PGN::san(pos, m);
+
+                    if (PGN::san_to_move(pos, san.data(), san.data() + san.size()) != m)
+                    {
+                        ++mismatches;
+                        sync_cout << "mismatch fen " << pos.fen() << " move " << UCI::move(m, pos)
+                                  << " san " << san << sync_endl;
+                    }
+                }
+
+            if (i == game.moves.size())
+                break;
+
+            cmd += " " + UCI::move(game.moves[i], pos);
+            states.emplace_back();
+            pos.do_move(game.moves[i], states.back());
+        }
+
+        if (print)
+            sync_cout << cmd << sync_endl;
+    });
+
+    elapsed = now() - elapsed + 1;
+
+    sync_cout << "games "          << games
+              << " moves "         << plies
+              << " errors "        << errors
+              << (check ? " mismatches " + to_string(mismatches) : "")
+              << " threads "       << threadCount
+              << " time "          << elapsed
+              << " games/minute "  << games * 60000 / elapsed << sync_endl;
+  }
+
+
+  // bench_compare() is called on "bench compare <samples> <mode> ... [bench
+  // parameters]". It collects the NPS of several bench runs and reports the
+  // mean speedup with a 95% confidence interval. The modes are:
+  //
+  // save <file>: stores the node count signature and the samples in a file
+  // load <file>: compares with the samples stored by an earlier 'save'
+  // option <name> = <a> <b>: alternates runs with the option set to a and b
+
+  void bench_compare(Position& pos, istream& args, StateListPtr& states) {
+
+    // Two-sided 95% quantiles of Student's t-distribution, by degrees of freedom
+    const double T95[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+                           2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+                           2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+    auto t95  = [&](size_t df) { return df < 31 ? T95[df] : 1.96; };
+    auto mean = [](const vector<double>& v) { return accumulate(v.begin(), v.end(), 0.0) / v.size(); };
+    auto var  = [&](const vector<double>& v) {
+        double m = mean(v), sum = 0;
+        for (double x : v)
+            sum += (x - m) * (x - m);
+        return v.size() > 1 ? sum / (v.size() - 1) : 0.0;
+    };
+
+    size_t samples = 0;
+    string mode, file, name, token;
+    vector<string> values;
+
+    args >> samples >> mode;
+
+    if (mode == "save" || mode == "load")
+        args >> file;
+
+    else if (mode == "option")
+    {
+        while (args >> token && token != "=")
+            name += (name.empty() ? "" : " ") + token;
+
+        values.resize(2);
+        args >> values[0] >> values[1];
+    }
+
+    if (   samples < 2
+        || (mode != "option" && file.empty())
+        || (mode == "option" && (!Options.count(name) || values[1].empty())))
+    {
+        cerr << "Usage: bench compare <samples> save|load <file> [bench parameters]\n"
+             << "       bench compare <samples> option <name> = <a> <b> [bench parameters]" << endl;
+        return;
+    }
+
+    vector<string> lists[2];
+    vector<double> nps[2];
+    uint64_t signature[2] = {};
+    size_t configs = values.empty() ? 1 : 2;
+    bool identical = true;
+
+    lists[0] = lists[1] = setup_bench(pos, args);
+
+    // Set the compared option after the Threads and Hash ones of the bench
+    for (size_t c = 0; c < configs && mode == "option"; ++c)
+        lists[c].insert(find_if(lists[c].begin(), lists[c].end(),
+                                [](const string& cmd) { return    cmd.find("position") == 0
+                                                               || cmd.find("fenfile") == 0; }),
+                        "setoption name " + name + " value " + values[c]);
+
+    // Alternate the order of the configurations from one sample to the next,
+    // so that a drift of the machine speed does not favour one of them.
+    for (size_t i = 0; i < samples; ++i)
+        for (size_t k = 0; k < configs; ++k)
+        {
+            size_t c = (i + k) % configs;
+
+            TimePoint elapsed = now();
+            uint64_t nodes = run_bench(pos, lists[c], states);
+            elapsed = now() - elapsed + 1;
+
+            identical &= !signature[c] || signature[c] == nodes;
+            signature[c] = nodes;
+            nps[c].push_back(1000.0 * nodes / elapsed);
+        }
+
+    if (mode == "save")
+    {
+        ofstream out(file);
+        out << "signature " << signature[0] << "\nnps";
+        for (double x : nps[0])
+            out << " " << uint64_t(x);
+        out << endl;
+    }
+    else if (mode == "load")
+    {
+        ifstream in(file);
+        in >> token >> signature[1] >> token;
+        for (double x; in >> x; )
+            nps[1].push_back(x);
+
+        if (nps[1].size() < 2)
+        {
+            cerr << "Unable to read bench record " << file << endl;
+            return;
+        }
+    }
+
+    dbg_print(); // Just before exiting
+
+    cerr << "\n===========================";
+
+    for (int c = 0; c < (mode == "save" ? 1 : 2); ++c)
+        cerr << "\n" << (mode == "option" ? name + " " + values[c]
+                        : c == 0          ? string("This binary")
+                                          : "Baseline " + file)
+             << ": " << uint64_t(mean(nps[c])) << " +- "
+             << uint64_t(t95(nps[c].size() - 1) * sqrt(var(nps[c]) / nps[c].size()))
+             << " nps, signature " << signature[c];
+
+    if (mode != "save")
+    {
+        double speedup, margin;
+
+        if (mode == "option") // Paired samples
+        {
+            vector<double> ratio;
+            for (size_t i = 0; i < samples; ++i)
+                ratio.push_back(nps[1][i] / nps[0][i]);
+
+            speedup = mean(ratio);
+            margin = t95(samples - 1) * sqrt(var(ratio) / samples);
+        }
+        else // Independent samples
+        {
+            double m0 = mean(nps[0]), m1 = mean(nps[1]);
+            speedup = m0 / m1;
+            margin = speedup * t95(std::min(nps[0].size(), nps[1].size()) - 1)
+                    * sqrt(var(nps[0]) / (nps[0].size() * m0 * m0) + var(nps[1]) / (nps[1].size() * m1 * m1));
+        }
+
+        identical &= signature[0] == signature[1];
+
+        cerr << "\nSpeedup         : " << fixed << setprecision(2) << 100 * (speedup - 1)
+             << "% +- " << 100 * margin << "%" << defaultfloat;
+    }
+
+    cerr << "\nSignature       : " << (identical ? "identical" : "DIFFERENT") << endl;
+  }
+
+
+  // bench() is called when engine receives the "bench" command. Firstly
+  // a list of UCI commands is setup according to bench parameters, then
+  // it is run one by one printing a summary at the end.
+
+  void bench(Position& pos, istream& args, StateListPtr& states) {
+
+    PerfCounters counters, *perf = nullptr;
+
+    if (args.peek() != EOF)
+    {
+        streampos start = args.tellg();
+        string token;
+
+        if (args >> token && token == "compare")
+        {
+            bench_compare(pos, args, states);
+            return;
+        }
+
+        if (token == "perf")
+            perf = &counters;
+        else
+        {
+            args.clear();
+            args.seekg(start);
+        }
+    }
+
+    vector<string> list = setup_bench(pos, args);
+
+    TimePoint elapsed = now();
+
+    uint64_t nodes = run_bench(pos, list, states, perf);
+
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print(); // Just before exiting
@@ -175,7 +690,193 @@ namespace {
     cerr << "\n==========================="
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
-         << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+         << "\nNodes/second    : " << 1000 * nodes / elapsed
+         << "\nMaterial entries: " << Material::stats()
+         << "\nMoveList cache  : " << MoveListCache::stats()
+         << (perf ? perf->report(nodes, "node") : "") << endl;
+  }
+
+
+  // eval_profile() is called on "evalprofile [perf] [iterations] [file]". It
+  // profiles the evaluation of the bench positions, or of the FEN or EPD lines
+  // of a file, and of their children which are not in check. With "perf" the
+  // hardware performance counters are also reported per evaluation.
+
+  void eval_profile(Position& pos, istream& args, StateListPtr& states) {
+
+#ifdef EVAL_PROFILE
+    int iterations = 1000;
+    string fname;
+    vector<string> fens;
+    PerfCounters perf;
+    uint64_t evaluations = 0;
+    bool usePerf = false;
+    streampos start = args.tellg();
+
+    if (args >> fname && fname == "perf")
+        usePerf = true;
+    else
+    {
+        args.clear();
+        args.seekg(start);
+    }
+
+    fname.clear();
+    args >> iterations >> fname;
+
+    if (fname.empty())
+    {
+        istringstream benchArgs("16 1 1 default");
+        for (const string& cmd : setup_bench(pos, benchArgs))
+            if (cmd.find("position fen ") == 0)
+                fens.push_back(cmd.substr(13));
+    }
+    else
+    {
+        MappedFile file(fname);
+
+        if (!file.is_open())
+        {
+            cerr << "Unable to open file " << fname << endl;
+            return;
+        }
+
+        const char *p = file.data(), *end = p + file.size(), *begin, *last;
+        while (next_line(p, end, begin, last))
+            fens.emplace_back(begin, last);
+    }
+
+    for (const string& fen : fens)
+    {
+        istringstream is("fen " + fen);
+        position(pos, is, states);
+
+        if (usePerf)
+            perf.start();
+
+        if (!pos.checkers())
+        {
+            Eval::profile(pos, iterations);
+            evaluations += iterations;
+        }
+
+        for (const auto& m : MoveList<LEGAL>(pos))
+        {
+            StateInfo st;
+            pos.do_move(m, st);
+            if (!pos.checkers())
+            {
+                Eval::profile(pos, iterations);
+                evaluations += iterations;
+            }
+            pos.undo_move(m);
+        }
+
+        if (usePerf)
+            perf.stop();
+    }
+
+    sync_cout << Eval::profile_report()
+              << (usePerf ? perf.report(evaluations, "eval") : "") << sync_endl;
+#else
+    (void)pos, (void)args, (void)states;
+    sync_cout << "evalprofile needs a build with evalprofile=yes" << sync_endl;
+#endif
+  }
+
+
+  // memory() accounts for the large allocations of the engine by subsystem and
+  // by thread, with their requested size and the part backed by physical memory.
+  // The brief form prints a single line, shown after the protocol handshake,
+  // as an info string in UCI mode and as a comment line in XBoard mode.
+
+  void memory(const Thread* uiThread, bool brief) {
+
+    enum { HASH, THREADS, PAWNS, MATERIAL, HISTORIES, MOVELISTS, QSEARCH, ENDGAMES,
+           TB_INDEX, TB_FILES, SUBSYSTEM_NB };
+
+    const char* names[] = { "Hash", "Thread objects", "Pawn tables", "Material tables",
+                            "Move histories", "MoveList caches", "QSearch hash",
+                            "Endgames", "Syzygy tables", "Syzygy mappings" };
+
+    size_t requested[SUBSYSTEM_NB] = {}, resident[SUBSYSTEM_NB] = {};
+    vector<pair<size_t, size_t>> perThread;
+
+    requested[HASH] = TT.size_bytes();
+    resident[HASH] = TT.resident();
+
+    vector<const Thread*> threads(Threads.begin(), Threads.end());
+    threads.push_back(uiThread);
+
+    for (const Thread* th : threads)
+    {
+        size_t req[SUBSYSTEM_NB] = {}, res[SUBSYSTEM_NB] = {};
+        size_t object = th == Threads.main() ? sizeof(MainThread) : sizeof(Thread);
+
+        req[THREADS]   = object;
+        res[THREADS]   = resident_bytes(th, object);
+        req[MOVELISTS] = th->moveListCache ? sizeof(MoveListCache) : 0;
+        res[MOVELISTS] = resident_bytes(th->moveListCache, req[MOVELISTS]);
+        req[PAWNS]     = th->pawnsTable.size_bytes();
+        res[PAWNS]     = th->pawnsTable.resident();
+        req[MATERIAL]  = th->materialTable.size_bytes();
+        res[MATERIAL]  = th->materialTable.resident();
+        req[HISTORIES] = sizeof(ThreadHistories);
+        res[HISTORIES] = resident_bytes(th->histories, sizeof(ThreadHistories));
+        req[QSEARCH]   = th->qsearchTT.size_bytes();
+        res[QSEARCH]   = th->qsearchTT.resident();
+        req[ENDGAMES]  = res[ENDGAMES] = th->endgames.size_bytes();
+
+        perThread.emplace_back(0, 0);
+        for (int i = THREADS; i <= ENDGAMES; ++i)
+        {
+            requested[i] += req[i];
+            resident[i]  += res[i];
+            perThread.back().first  += req[i];
+            perThread.back().second += res[i];
+        }
+    }
+
+    Tablebases::memory(requested[TB_INDEX], requested[TB_FILES], resident[TB_FILES]);
+    resident[TB_INDEX] = requested[TB_INDEX];
+
+    size_t totalRequested = accumulate(requested, requested + SUBSYSTEM_NB, size_t(0));
+    size_t totalResident = accumulate(resident, resident + SUBSYSTEM_NB, size_t(0));
+    size_t rss = process_memory("VmRSS"), peak = process_memory("VmHWM");
+
+    auto mb = [](size_t bytes) {
+        stringstream ss;
+        ss << fixed << setprecision(1) << setw(10) << bytes / 1048576.0 << " MB";
+        return ss.str();
+    };
+
+    if (brief)
+    {
+        sync_cout << (Options["Protocol"] == "xboard" ? "# " : "info string ")
+                  << "Memory " << (totalRequested + 524288) / 1048576
+                  << " MB requested, " << (totalResident + 524288) / 1048576 << " MB resident"
+                  << (rss ? ", process RSS " + to_string((rss + 524288) / 1048576) + " MB" : "")
+                  << sync_endl;
+        return;
+    }
+
+    stringstream ss;
+    ss << left << setw(18) << "Subsystem" << right << setw(13) << "Requested"
+       << setw(13) << "Resident" << "\n";
+
+    for (int i = HASH; i < SUBSYSTEM_NB; ++i)
+        ss << left << setw(18) << names[i] << right << mb(requested[i]) << mb(resident[i]) << "\n";
+
+    ss << left << setw(18) << "Total" << right << mb(totalRequested) << mb(totalResident) << "\n\n";
+
+    for (size_t i = 0; i < perThread.size(); ++i)
+        ss << left << setw(18) << (i < Threads.size() ? "Thread " + to_string(i) : "UI thread")
+           << right << mb(perThread[i].first) << mb(perThread[i].second) << "\n";
+
+    ss << "\n" << left << setw(18) << "Process RSS" << right
+       << (rss ? mb(rss) + "\n" + "Process peak RSS  " + mb(peak) : "not available");
+
+    sync_cout << ss.str() << sync_endl;
   }
 
 } // namespace
@@ -231,6 +932,8 @@ void UCI::loop(int argc, char* argv[]) {
               sync_cout << "id name " << engine_info(true)
                           << "\n" << Options
                           << "\n" << token << "ok"  << sync_endl;
+
+          memory(uiThread.get(), true);
       }
 
       else if (Options["Protocol"] == "xboard")
@@ -245,13 +948,21 @@ void UCI::loop(int argc, char* argv[]) {
       else if (token == "go")         go(pos, is, states);
       else if (token == "position")   position(pos, is, states);
       else if (token == "ucinewgame") Search::clear();
-      else if (token == "isready")    sync_cout << "readyok" << sync_endl;
+      else if (token == "isready")
+      {
+          Bitbases::wait();
+          sync_cout << "readyok" << sync_endl;
+      }
 
       // Additional custom non-UCI commands, mainly for debugging
       else if (token == "flip")  pos.flip();
       else if (token == "bench") bench(pos, is, states);
       else if (token == "d")     sync_cout << pos << sync_endl;
       else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+      else if (token == "evalprofile") eval_profile(pos, is, states);
+      else if (token == "analyzegame") analyze_game(pos, is, states);
+      else if (token == "pgn")   read_pgn(is);
+      else if (token == "memory") memory(uiThread.get(), false);
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
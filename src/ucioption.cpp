@@ -41,8 +41,12 @@ namespace UCI {
 void on_clear_hash(const Option&) { Search::clear(); }
 void on_hash_size(const Option& o) { TT.resize(o); }
 void on_logger(const Option& o) { start_logger(o); }
+void on_material_cache(const Option& o) { Material::UseThreadTable = o; }
+void on_movelist_cache(const Option&) { Threads.set(Options["Threads"]); }
+void on_qsearch_hash(const Option&) { Threads.set(Options["Threads"]); }
 void on_threads(const Option& o) { Threads.set(o); }
 void on_tb_path(const Option& o) { Tablebases::init(o); }
+void on_tb_index(const Option&) { Tablebases::init(Options["SyzygyPath"]); }
 void on_variant(const Option& o) {
     if (Options["Protocol"] == "xboard")
     {
@@ -88,19 +92,22 @@ bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const
 
 void init(OptionsMap& o) {
 
-  // at most 2^32 clusters.
-  constexpr int MaxHashMB = Is64Bit ? 131072 : 2048;
-
   o["Protocol"]              << Option("uci", {"uci", "xboard"});
   o["Debug Log File"]        << Option("", on_logger);
   o["Contempt"]              << Option(21, -100, 100);
   o["Analysis Contempt"]     << Option("Both", {"Both", "Off", "White", "Black"});
   o["Threads"]               << Option(1, 1, 512, on_threads);
-  o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
+  o["Hash"]                  << Option(16, 1, TranspositionTable::MaxHashMB, on_hash_size);
+  o["Auto Hash"]             << Option(false);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["QSearch Hash"]          << Option(0, 0, 16, on_qsearch_hash);
+  o["Thread Material Cache"] << Option(true, on_material_cache);
+  o["MoveList Cache"]        << Option(false, on_movelist_cache);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
   o["Skill Level"]           << Option(20, 0, 20);
+  o["Handicap Level"]        << Option(20, 0, 20);
+  o["Handicap Nodes"]        << Option(10000, 16, 1000000);
   o["Move Overhead"]         << Option(30, 0, 5000);
   o["Minimum Thinking Time"] << Option(20, 0, 5000);
   o["Slow Mover"]            << Option(84, 10, 1000);
@@ -109,6 +116,7 @@ void init(OptionsMap& o) {
   o["UCI_Chess960"]          << Option(false);
   o["UCI_AnalyseMode"]       << Option(false);
   o["SyzygyPath"]            << Option("<empty>", on_tb_path);
+  o["SyzygyIndex"]           << Option("<empty>", on_tb_index);
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(6, 0, 6);
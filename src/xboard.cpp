@@ -110,6 +110,7 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
   {
       if (!(is >> token))
           token = "";
+      Bitbases::wait();
       sync_cout << "pong " << token << sync_endl;
   }
   else if (token == "new")
@@ -0,0 +1,49 @@
+#!/bin/bash
+# verify the PGN reader and the SAN round trip
+
+error()
+{
+  echo "pgn testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "pgn testing started"
+
+# games with gating, castling, captures, checks, promotions, en passant and
+# chess960 castling. With "check" every legal move of every position of the
+# games is converted to SAN and back, so disambiguations are covered too.
+cat << EOF > games.pgn
+[Event "castling and gating"]
+[Result "*"]
+
+1. C L 2. C@b1 C@b8 3. L@c1 L@c8 4. e4 e5 5. Nf3 Nf6 6. Bc4 Bc5 7. O-O O-O
+8. Nc3/C Nc6/C 9. d3 d6 10. Bg5/L Bg4/L 11. Bxf6 Qxf6 12. Nd5 Qd8 13. h3 Bxf3
+14. Qxf3 Nd4 15. Qg3 c6 16. Nf6+ Qxf6 17. c3 Ne6 *
+
+[Event "queenside"]
+[Result "*"]
+
+1. L C 2. L@f1 L@f8 3. C@g1 C@g8 4. d4 d5 5. Nc3 Nc6 6. Bf4 Bf5 7. Qd2 Qd7
+8. O-O-O O-O-O 9. e3 e6 10. Bb5 Bb4 11. Nf3/C Nf6/C 12. Bxc6 Bxc3 *
+
+[Event "promotion and en passant"]
+[FEN "4k3/1P6/8/3pP3/8/8/6p1/R3K2R[C-L-c-l-] w KQ d6 0 1"]
+[Result "*"]
+
+1. exd6 g1=Q+ 2. Rxg1 Kd7 3. b8=N+ Kxd6 4. O-O-O+ *
+
+[Event "chess960 castling"]
+[Variant "Chess960"]
+[FEN "4k3/8/8/8/8/8/8/R3K2R[C-L-c-l-] w KQ - 0 1"]
+[Result "*"]
+
+1. O-O Kd7 2. Rfe1 *
+EOF
+
+./stockfish pgn games.pgn 1 check | grep -q "games 4 moves 68 errors 0 mismatches 0 "
+./stockfish pgn games.pgn 1 moves | grep -q "moves e1h1 e8d7 f1e1$"
+
+rm games.pgn
+
+echo "pgn testing OK"